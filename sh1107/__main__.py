@@ -2,7 +2,7 @@ import warnings
 from argparse import ArgumentParser
 from os import makedirs
 
-from . import build, formal, rom, test, vsh
+from . import bench, build, formal, rom, test, vsh
 from .base import path
 
 warnings.simplefilter("default")
@@ -43,5 +43,12 @@ vsh.add_main_arguments(
     )
 )
 
+bench.add_main_arguments(
+    subparsers.add_parser(
+        "bench",
+        help="benchmark vsh across blackbox/whitebox and build configurations",
+    )
+)
+
 args = parser.parse_args()
 args.func(args)
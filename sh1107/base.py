@@ -13,6 +13,7 @@ class Blackbox(Enum):
     I2C = 1
     SPIFR = 2
     SPIFR_WHITEBOX = 3
+    I2C_WHITEBOX = 4
 
 
 Blackboxes: TypeAlias = set[Blackbox]
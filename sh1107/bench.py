@@ -0,0 +1,152 @@
+import re
+import subprocess
+from argparse import ArgumentParser, Namespace
+from dataclasses import dataclass
+from itertools import product
+from typing import Optional
+
+from . import vsh
+from .base import path
+from .rtl.oled import OLED
+
+__all__ = ["add_main_arguments"]
+
+
+@dataclass
+class _Result:
+    blackbox_i2c: bool
+    blackbox_spifr: bool
+    optimize: vsh._Optimize
+    speed: int
+    cycles: int
+    seconds: float
+    khz: float
+    full_frame_cycle: Optional[int]
+    full_frame_seconds: Optional[float]
+
+
+_CYCLES = re.compile(
+    r"^(\d+) cycles in ([\d.]+)s \(([\d.]+) kHz\)$", flags=re.MULTILINE
+)
+_FULL_FRAME = re.compile(
+    r"^first full frame at cycle (\d+) \(([\d.]+)s\)$", flags=re.MULTILINE
+)
+
+
+def add_main_arguments(parser: ArgumentParser):
+    parser.set_defaults(func=main)
+    parser.add_argument(
+        "-n",
+        "--cycles",
+        type=int,
+        help="number of cycles to run each configuration for (default: 4000000)",
+        default=4_000_000,
+    )
+    parser.add_argument(
+        "-p",
+        "--press",
+        type=int,
+        help="switch to press at the start of each run (default: 1, i.e. init, CLS and some PRINTs)",
+        default=1,
+    )
+    parser.add_argument(
+        "-s",
+        "--speed",
+        action="append",
+        choices=[str(s) for s in OLED.VALID_SPEEDS],
+        help="I2C bus speed to build at; may be given multiple times (default: all)",
+    )
+    parser.add_argument(
+        "-O",
+        "--optimize",
+        action="append",
+        type=vsh._Optimize,
+        choices=vsh._Optimize,
+        help="optimization setting to build with; may be given multiple times (default: all)",
+    )
+    parser.add_argument(
+        "-t",
+        "--top",
+        help="which top-level module to simulate (default: sh1107.rtl.Top)",
+        default="sh1107.rtl.Top",
+    )
+
+
+def main(args: Namespace):
+    speeds = args.speed or [str(s) for s in OLED.VALID_SPEEDS]
+    optimizes = args.optimize or list(vsh._Optimize)
+
+    # Each configuration's flags go through vsh's own parser, so every other
+    # option gets vsh's default, including ones added after this was written.
+    vsh_parser = ArgumentParser()
+    vsh.add_main_arguments(vsh_parser)
+
+    results: list[_Result] = []
+    for blackbox_i2c, blackbox_spifr, optimize, speed in product(
+        [True, False], [True, False], optimizes, speeds
+    ):
+        vsh_args = vsh_parser.parse_args(
+            [
+                *([] if blackbox_i2c else ["--whitebox-i2c"]),
+                *([] if blackbox_spifr else ["--whitebox-spifr"]),
+                *["--speed", speed],
+                *["--top", args.top],
+                *["--optimize", str(optimize)],
+                "--headless",
+                *["--cycles", str(args.cycles)],
+                *["--press", str(args.press)],
+            ]
+        )
+        print(f"bench: {_describe(blackbox_i2c, blackbox_spifr, optimize, speed)}")
+        cmd = vsh.build(vsh_args) + ["run", "--", *vsh.vsh_arguments(vsh_args)]
+        out = subprocess.run(
+            cmd, cwd=path("vsh"), check=True, capture_output=True, text=True
+        ).stdout
+
+        m = _CYCLES.search(out)
+        assert m, f"unexpected output from vsh: {out!r}"
+        ff = _FULL_FRAME.search(out)
+        results.append(
+            _Result(
+                blackbox_i2c=blackbox_i2c,
+                blackbox_spifr=blackbox_spifr,
+                optimize=optimize,
+                speed=int(speed),
+                cycles=int(m[1]),
+                seconds=float(m[2]),
+                khz=float(m[3]),
+                full_frame_cycle=int(ff[1]) if ff else None,
+                full_frame_seconds=float(ff[2]) if ff else None,
+            )
+        )
+
+    print()
+    print(
+        f"{'i2c':<8} {'spifr':<8} {'-O':<5} {'speed':>8} "
+        f"{'kHz':>9} {'full frame':>11} {'at cycle':>10}"
+    )
+    for r in results:
+        full_frame = (
+            f"{r.full_frame_seconds:.3f}s" if r.full_frame_seconds is not None else "-"
+        )
+        full_frame_cycle = (
+            str(r.full_frame_cycle) if r.full_frame_cycle is not None else "-"
+        )
+        print(
+            f"{_box(r.blackbox_i2c):<8} {_box(r.blackbox_spifr):<8} "
+            f"{str(r.optimize):<5} {r.speed:>8} "
+            f"{r.khz:>9.1f} {full_frame:>11} {full_frame_cycle:>10}"
+        )
+
+
+def _box(blackbox: bool) -> str:
+    return "black" if blackbox else "white"
+
+
+def _describe(
+    blackbox_i2c: bool, blackbox_spifr: bool, optimize: vsh._Optimize, speed: str
+) -> str:
+    return (
+        f"i2c={_box(blackbox_i2c)} spifr={_box(blackbox_spifr)} "
+        f"-O {optimize} -s {speed}"
+    )
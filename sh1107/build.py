@@ -82,6 +82,8 @@ def build_top(args: Namespace, platform: Platform, **kwargs: Any) -> Elaboratabl
     blackboxes = kwargs.pop("blackboxes", Blackboxes())
     if kwargs.get("blackbox_i2c", getattr(args, "blackbox_i2c", False)):
         blackboxes.add(Blackbox.I2C)
+    elif getattr(args, "i2c_whitebox", False):
+        blackboxes.add(Blackbox.I2C_WHITEBOX)
     if kwargs.get("blackbox_spifr", getattr(args, "blackbox_spifr", False)):
         blackboxes.add(Blackbox.SPIFR)
     else:
@@ -8,7 +8,7 @@ from amaranth.build import Platform as AmaranthPlatform
 from amaranth_boards.icebreaker import ICEBreakerPlatform
 from amaranth_boards.orangecrab_r0_2 import OrangeCrabR0_2_85FPlatform
 
-from .base import Blackboxes
+from .base import Blackbox, Blackboxes
 
 __all__ = ["Platform"]
 
@@ -35,6 +35,13 @@ class PlatformRegistry(ABCMeta):
 
 class Platform(metaclass=PlatformRegistry):
     blackboxes: Blackboxes = set()
+    blackbox_parameters: dict[Blackbox, dict[str, int]] = {}
+
+    def blackbox_instance_parameters(self, blackbox: Blackbox) -> dict[str, int]:
+        return {
+            f"p_{name}": value
+            for name, value in self.blackbox_parameters.get(blackbox, {}).items()
+        }
 
     @property
     @abstractmethod
@@ -143,7 +143,12 @@ class Top(Component):
     def ports(self, platform: Platform) -> list[Signal]:
         ports = self.switches[:]
 
-        if Blackbox.I2C not in platform.blackboxes:
+        # With either C++ I2C cell, the SH1107 model inside it is all vsh
+        # needs; otherwise vsh decodes the bus itself.
+        if (
+            Blackbox.I2C not in platform.blackboxes
+            and Blackbox.I2C_WHITEBOX not in platform.blackboxes
+        ):
             ports += [
                 self._oled._i2c.hw_bus.scl_o,
                 self._oled._i2c.hw_bus.scl_oe,
@@ -151,12 +156,6 @@ class Top(Component):
                 self._oled._i2c.hw_bus.sda_oe,
                 self._oled._i2c.hw_bus.sda_i,
             ]
-        else:
-            ports += [
-                self._oled._i_i2c_bb_in_ack,
-                self._oled._i_i2c_bb_in_out_fifo_data,
-                self._oled._i_i2c_bb_in_out_fifo_stb,
-            ]
 
         return ports
 
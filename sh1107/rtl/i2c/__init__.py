@@ -62,6 +62,7 @@ I2CBus = Signature(
         "in_fifo_w_en": Out(1),
         "out_fifo_r_en": Out(1),
         "stb": Out(1),
+        "stop": Out(1),
         "ack": In(1, init=1),
         "busy": In(1),
         "in_fifo_w_rdy": In(1),
@@ -97,6 +98,11 @@ class I2C(Component):
     cause a return to idle.  To issue a repeated start, instead write Cat(rw<1>,
     addr<7>, 1<1>).
 
+    When there's nothing more to queue, users hold stop high while waiting for
+    busy to go low.  We don't need it -- the transaction ends at the ACK of the
+    last byte if the FIFO is empty -- but the vsh blackbox can use it to end
+    transactions without guessing.
+
     Read: Not yet implemented.
     """
 
@@ -107,6 +113,8 @@ class I2C(Component):
         2_000_000,  # for vsh
     ]
 
+    IN_FIFO_DEPTH: Final[int] = 1
+
     _speed: Hz
 
     _in_fifo: SyncFIFO
@@ -134,7 +142,7 @@ class I2C(Component):
         assert speed.value in self.VALID_SPEEDS
         self.speed = speed
 
-        self._in_fifo = SyncFIFO(width=9, depth=1)
+        self._in_fifo = SyncFIFO(width=9, depth=self.IN_FIFO_DEPTH)
         self._in_fifo_r_data = Transfer(target=self._in_fifo.r_data)
 
         self._out_fifo = SyncFIFO(width=8, depth=1)
@@ -1,10 +1,11 @@
 from enum import Enum
 from typing import Callable, Literal, Optional, cast
 
-from amaranth import Signal
+from amaranth import Elaboratable, Module, Signal
 from amaranth.sim import Delay
 
 from ... import sim
+from ...platform import Platform
 from . import I2C
 
 __all__ = [
@@ -17,6 +18,8 @@ __all__ = [
     "stop",
     "steady_stopped",
     "full_sequence",
+    "StopMonitor",
+    "check_stop",
 ]
 
 
@@ -319,3 +322,59 @@ def full_sequence(
 
         yield from stop(i2c)
         yield from steady_stopped(i2c)
+
+
+class StopMonitor(Elaboratable):
+    """
+    Watches a user of an I2C for how it ends transactions: stop only goes high
+    once the last byte's queued, stays high until busy falls, and the user's own
+    busy doesn't fall before the I2C's.  Anything else latches one of the flags
+    check_stop looks at.
+    """
+
+    _i2c: I2C
+    _busy: Signal
+
+    stopped: Signal
+    queued_after_stop: Signal
+    stop_dropped: Signal
+    idle_early: Signal
+
+    def __init__(self, i2c: I2C, busy: Signal):
+        self._i2c = i2c
+        self._busy = busy
+
+        self.stopped = Signal()
+        self.queued_after_stop = Signal()
+        self.stop_dropped = Signal()
+        self.idle_early = Signal()
+
+    def elaborate(self, platform: Platform) -> Elaboratable:
+        m = Module()
+
+        bus = self._i2c.bus
+        holding = Signal()
+
+        with m.If(~bus.busy):
+            m.d.sync += holding.eq(0)
+        with m.Elif(bus.stop):
+            m.d.sync += [
+                holding.eq(1),
+                self.stopped.eq(1),
+            ]
+
+        with m.If((bus.stop | holding) & bus.in_fifo_w_en):
+            m.d.sync += self.queued_after_stop.eq(1)
+        with m.If(holding & ~bus.stop & bus.busy):
+            m.d.sync += self.stop_dropped.eq(1)
+        with m.If(~self._busy & bus.busy):
+            m.d.sync += self.idle_early.eq(1)
+
+        return m
+
+
+def check_stop(monitor: StopMonitor) -> sim.Procedure:
+    assert (yield monitor.stopped), "stop was never raised"
+    assert not (yield monitor.queued_after_stop), "a byte was queued after stop"
+    assert not (yield monitor.stop_dropped), "stop fell while the I2C was busy"
+    assert not (yield monitor.idle_early), "went idle while the I2C was busy"
@@ -72,10 +72,6 @@ class OLED(Component):
     i2c_bus: Out(I2CBus)
     own_i2c_bus: Out(I2CBus)
     _i2c: I2C | Instance
-    # For blackbox simulation only; not defined otherwise.
-    _i_i2c_bb_in_ack: Signal
-    _i_i2c_bb_in_out_fifo_data: Signal
-    _i_i2c_bb_in_out_fifo_stb: Signal
 
     spifr_bus: Out(SPIFlashReaderBus)
     _spifr: SPIFlashReader | Instance
@@ -123,9 +119,6 @@ class OLED(Component):
         if Blackbox.I2C not in platform.blackboxes:
             self._i2c = I2C(speed=speed)
         else:
-            self._i_i2c_bb_in_ack = Signal()
-            self._i_i2c_bb_in_out_fifo_data = Signal(8)
-            self._i_i2c_bb_in_out_fifo_stb = Signal()
             self._i2c = Instance(
                 "i2c",
                 i_clk=ClockSignal(),
@@ -133,14 +126,17 @@ class OLED(Component):
                 i_in_fifo_w_en=self.i2c_bus.in_fifo_w_en,
                 i_out_fifo_r_en=self.i2c_bus.out_fifo_r_en,
                 i_stb=self.i2c_bus.stb,
-                i_bb_in_ack=self._i_i2c_bb_in_ack,
-                i_bb_in_out_fifo_data=self._i_i2c_bb_in_out_fifo_data,
-                i_bb_in_out_fifo_stb=self._i_i2c_bb_in_out_fifo_stb,
+                i_stop=self.i2c_bus.stop,
                 o_ack=self.i2c_bus.ack,
                 o_busy=self.i2c_bus.busy,
                 o_in_fifo_w_rdy=self.i2c_bus.in_fifo_w_rdy,
                 o_out_fifo_r_rdy=self.i2c_bus.out_fifo_r_rdy,
                 o_out_fifo_r_data=self.i2c_bus.out_fifo_r_data,
+                **{
+                    "p_ADDR": self._addr,
+                    "p_IN_FIFO_DEPTH": I2C.IN_FIFO_DEPTH,
+                    **platform.blackbox_instance_parameters(Blackbox.I2C),
+                },
             )
 
         if Blackbox.SPIFR not in platform.blackboxes:
@@ -155,6 +151,7 @@ class OLED(Component):
                 o_busy=self.spifr_bus.busy,
                 o_data=self.spifr_bus.data,
                 o_valid=self.spifr_bus.valid,
+                **platform.blackbox_instance_parameters(Blackbox.SPIFR),
             )
 
         self._rom_wr_en = Signal()
@@ -224,7 +221,14 @@ class OLED(Component):
                         )
                     ),
                 ]
-                m.next = "INIT: WAIT SPIFR"
+                # The flash reader blackbox can present bytes back-to-back.
+                with m.If(self.spifr_bus.valid):
+                    m.d.sync += [
+                        self._rom_wr_data.eq(self.spifr_bus.data),
+                        self._rom_wr_en.eq(1),
+                    ]
+                with m.Else():
+                    m.next = "INIT: WAIT SPIFR"
 
             with m.State("IDLE"):
                 with m.If(self._cursor_c.full):
@@ -403,8 +407,10 @@ class OLED(Component):
         rd_data = Signal(16)
         wr_en = Signal(2)
 
-        # Decisions about which part of the word to use need to be based on the
-        # issuing cycle's address.
+        # Decisions about which part of the word to use for reads need to be
+        # based on the issuing cycle's address.  Writes happen in the cycle
+        # they're issued, so they use the current one; this matters when the
+        # address moves on every cycle.
         effective_addr = Signal.like(self.rom_bus.addr)
         m.d.sync += effective_addr.eq(self.rom_bus.addr)
 
@@ -413,7 +419,7 @@ class OLED(Component):
             self.rom_bus.data.eq(rd_data.word_select(effective_addr[0], 8)),
             wr_en.eq(
                 self._rom_wr_en.replicate(2)
-                & Mux(effective_addr[0], C(0b10, 2), C(0b01, 2))
+                & Mux(self.rom_bus.addr[0], C(0b10, 2), C(0b01, 2))
             ),
         ]
 
@@ -465,6 +471,19 @@ class OLED(Component):
         if Blackbox.I2C not in platform.blackboxes:
             connect(m, self.i2c_bus, self._i2c.bus)
 
+        if Blackbox.I2C_WHITEBOX in platform.blackboxes:
+            hw_bus = self._i2c.hw_bus
+            m.submodules.i2c_whitebox = Instance(
+                "i2c_whitebox",
+                i_clk=ClockSignal(),
+                i_scl_o=hw_bus.scl_o,
+                i_scl_oe=hw_bus.scl_oe,
+                i_sda_o=hw_bus.sda_o,
+                i_sda_oe=hw_bus.sda_oe,
+                o_sda_i=hw_bus.sda_i,
+                p_ADDR=self._addr,
+            )
+
         if Blackbox.SPIFR not in platform.blackboxes:
             connect(m, self._spifr.bus, self.spifr_bus)
 
@@ -761,6 +780,7 @@ class OLED(Component):
 
         with m.State("ID: RECV: STROBED R_EN"):
             m.d.sync += self.own_i2c_bus.out_fifo_r_en.eq(0)
+            m.d.comb += self.own_i2c_bus.stop.eq(1)
             with m.If(~self.own_i2c_bus.busy):
                 first_half = id_recvd[4:8]
                 m.d.sync += [
@@ -183,8 +183,7 @@ class Clser(Component):
                         ]
                         m.next = "LOOP: NEXT PAGE: ADDR: STROBED W_EN"
                     with m.Else():
-                        m.d.sync += self.busy.eq(0)
-                        m.next = "IDLE"
+                        m.next = "FIN: WAIT I2C DONE"
                 with m.Elif(~self.i2c_bus.busy):
                     m.d.sync += self.busy.eq(0)
                     m.next = "IDLE"
@@ -193,4 +192,10 @@ class Clser(Component):
                 m.d.sync += self.i2c_bus.in_fifo_w_en.eq(0)
                 m.next = "START: ADDR: STROBED STB"
 
+            with m.State("FIN: WAIT I2C DONE"):
+                m.d.comb += self.i2c_bus.stop.eq(1)
+                with m.If(~self.i2c_bus.busy):
+                    m.d.sync += self.busy.eq(0)
+                    m.next = "IDLE"
+
         return m
@@ -84,8 +84,7 @@ class Locator(Component):
                         self.start_row(m)
                         m.next = "START: COL LOWER: STROBED W_EN"
                     with m.Else():
-                        m.d.sync += self.busy.eq(0)
-                        m.next = "IDLE"
+                        m.next = "FIN: WAIT I2C DONE"
                 with m.Elif(~self.i2c_bus.busy):
                     m.d.sync += self.busy.eq(0)
                     m.next = "IDLE"
@@ -95,6 +94,7 @@ class Locator(Component):
                 m.next = "START: PAGE: UNSTROBED W_EN"
 
             with m.State("START: PAGE: UNSTROBED W_EN"):
+                m.d.comb += self.i2c_bus.stop.eq(self.row == 0)
                 with m.If(self.row != 0):
                     with m.If(
                         self.i2c_bus.busy
@@ -135,6 +135,7 @@ class Locator(Component):
                 m.next = "START: COL HIGHER: UNSTROBED W_EN"
 
             with m.State("START: COL HIGHER: UNSTROBED W_EN"):
+                m.d.comb += self.i2c_bus.stop.eq(1)
                 with m.If(
                     ~self.i2c_bus.busy & self.i2c_bus.ack & self.i2c_bus.in_fifo_w_rdy
                 ):
@@ -144,6 +145,12 @@ class Locator(Component):
                     m.d.sync += self.busy.eq(0)
                     m.next = "IDLE"
 
+            with m.State("FIN: WAIT I2C DONE"):
+                m.d.comb += self.i2c_bus.stop.eq(1)
+                with m.If(~self.i2c_bus.busy):
+                    m.d.sync += self.busy.eq(0)
+                    m.next = "IDLE"
+
         return m
 
     def start_row(self, m: Module):
@@ -149,6 +149,7 @@ class ROMWriter(Component):
                 m.next = "LOOP HEAD: SEQ BREAK OR WAIT I2C"
 
             with m.State("FIN: WAIT I2C DONE"):
+                m.d.comb += self.i2c_bus.stop.eq(1)
                 with m.If(
                     ~self.i2c_bus.busy & self.i2c_bus.ack & self.i2c_bus.in_fifo_w_rdy
                 ):
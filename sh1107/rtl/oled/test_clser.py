@@ -18,18 +18,21 @@ class TestClserTop(Elaboratable):
 
     i2c: I2C
     clser: Clser
+    stop_monitor: sim_i2c.StopMonitor
 
     def __init__(self, *, speed: Hz):
         self.speed = speed
 
         self.i2c = I2C(speed=speed)
         self.clser = Clser(addr=TestClserTop.ADDR)
+        self.stop_monitor = sim_i2c.StopMonitor(self.i2c, self.clser.busy)
 
     def elaborate(self, platform: Optional[Platform]) -> Elaboratable:
         m = Module()
 
         m.submodules.i2c = self.i2c
         m.submodules.clser = self.clser
+        m.submodules.stop_monitor = self.stop_monitor
 
         connect(m, self.i2c.bus, self.clser.i2c_bus)
 
@@ -72,3 +75,5 @@ class TestClser(sim.TestCase):
             ],
             test_nacks=False,
         )
+        yield from sim_i2c.check_stop(dut.stop_monitor)
+        assert not (yield dut.clser.busy)
@@ -18,18 +18,21 @@ class TestLocatorTop(Elaboratable):
 
     i2c: I2C
     locator: Locator
+    stop_monitor: sim_i2c.StopMonitor
 
     def __init__(self, *, speed: Hz):
         self.speed = speed
 
         self.i2c = I2C(speed=speed)
         self.locator = Locator(addr=TestLocatorTop.ADDR)
+        self.stop_monitor = sim_i2c.StopMonitor(self.i2c, self.locator.busy)
 
     def elaborate(self, platform: Platform) -> Elaboratable:
         m = Module()
 
         m.submodules.i2c = self.i2c
         m.submodules.locator = self.locator
+        m.submodules.stop_monitor = self.stop_monitor
 
         connect(m, self.i2c.bus, self.locator.i2c_bus)
 
@@ -57,6 +60,8 @@ class TestLocator(sim.TestCase):
                 0x17,
             ],
         )
+        yield from sim_i2c.check_stop(dut.stop_monitor)
+        assert not (yield dut.locator.busy)
 
     @sim.i2c_speeds
     def test_sim_locator_row_only(self, dut: TestLocatorTop) -> sim.Procedure:
@@ -77,6 +82,8 @@ class TestLocator(sim.TestCase):
                 0x13,
             ],
         )
+        yield from sim_i2c.check_stop(dut.stop_monitor)
+        assert not (yield dut.locator.busy)
 
     @sim.i2c_speeds
     def test_sim_locator_col_only(self, dut: TestLocatorTop) -> sim.Procedure:
@@ -96,3 +103,25 @@ class TestLocator(sim.TestCase):
                 0xB3,
             ],
         )
+        yield from sim_i2c.check_stop(dut.stop_monitor)
+        assert not (yield dut.locator.busy)
+
+    @sim.i2c_speeds
+    def test_sim_locator_neither(self, dut: TestLocatorTop) -> sim.Procedure:
+        def trigger() -> sim.Procedure:
+            yield dut.locator.row.eq(0)
+            yield dut.locator.col.eq(0)
+            yield dut.locator.stb.eq(1)
+            yield Tick()
+            yield dut.locator.stb.eq(0)
+
+        yield from sim_i2c.full_sequence(
+            dut.i2c,
+            trigger,
+            [
+                0x17A,
+                0x00,
+            ],
+        )
+        yield from sim_i2c.check_stop(dut.stop_monitor)
+        assert not (yield dut.locator.busy)
@@ -0,0 +1,94 @@
+from amaranth import Elaboratable, Memory, Module, Signal
+from amaranth.lib.wiring import Component, In, connect
+from amaranth.sim import Tick
+
+from ... import rom, sim
+from ...base import Blackbox
+from ...platform import Platform
+from ..common import Hz
+from ..spi import SPIFlashReaderBus
+from . import OLED
+
+
+class MockBurstFlashReader(Component):
+    """
+    Stands in for the flash reader blackbox with a byte period of 1 (vsh -B):
+    once strobed, presents the next byte of data every cycle until len are done.
+    """
+
+    _data: bytes
+
+    bus: In(SPIFlashReaderBus)
+
+    def __init__(self, *, data: bytes):
+        super().__init__()
+        self._data = data
+
+    def elaborate(self, platform: Platform) -> Elaboratable:
+        m = Module()
+
+        m.submodules.rd = rd = Memory(
+            width=8, depth=len(self._data), init=self._data
+        ).read_port(domain="comb")
+        remaining = Signal.like(self.bus.len)
+
+        m.d.comb += self.bus.data.eq(rd.data)
+
+        with m.If(self.bus.stb):
+            m.d.sync += [
+                self.bus.busy.eq(1),
+                rd.addr.eq(0),
+                remaining.eq(self.bus.len),
+            ]
+        with m.Elif(remaining != 0):
+            m.d.comb += self.bus.valid.eq(1)
+            m.d.sync += [
+                rd.addr.eq(rd.addr + 1),
+                remaining.eq(remaining - 1),
+            ]
+        with m.Elif(self.bus.busy):
+            m.d.sync += self.bus.busy.eq(0)
+
+        return m
+
+
+class TestOLEDTop(Elaboratable):
+    oled: OLED
+    flash: MockBurstFlashReader
+
+    def __init__(self, *, platform: Platform):
+        # Have the OLED expect a flash reader blackbox, then put our mock where
+        # the Instance would be.
+        platform.blackboxes = {Blackbox.SPIFR}
+        self.oled = OLED(platform=platform, speed=Hz(OLED.DEFAULT_SPEED))
+        self.flash = MockBurstFlashReader(data=rom.ROM_CONTENT)
+        self.oled._spifr = self.flash
+
+    def elaborate(self, platform: Platform) -> Elaboratable:
+        m = Module()
+
+        m.submodules.oled = self.oled
+
+        connect(m, self.oled.spifr_bus, self.flash.bus)
+
+        return m
+
+
+class TestOLED(sim.TestCase):
+    def test_sim_rom_load_back_to_back(self, dut: TestOLEDTop) -> sim.Procedure:
+        # A byte a cycle, plus a few to strobe the reader and see it finish.
+        for _ in range(rom.ROM_LENGTH + 8):
+            if (yield dut.oled.result) == OLED.Result.SUCCESS:
+                break
+            yield Tick()
+        else:
+            raise AssertionError("ROM didn't load at a byte a cycle")
+
+        for i in range(0, rom.ROM_LENGTH, 2):
+            expected = rom.ROM_CONTENT[i]
+            if i + 1 < rom.ROM_LENGTH:
+                expected |= rom.ROM_CONTENT[i + 1] << 8
+            word = yield dut.oled._rom_mem[i // 2]
+            self.assertEqual(
+                word, expected, f"ROM bytes {i}-{i + 1}: {word:04x} != {expected:04x}"
+            )
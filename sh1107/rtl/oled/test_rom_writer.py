@@ -21,6 +21,7 @@ class TestROMWriterTop(Elaboratable):
     i2c: I2C
     rom_rd: ReadPort
     rom_writer: ROMWriter
+    stop_monitor: sim_i2c.StopMonitor
 
     def __init__(self, *, speed: Hz):
         self.speed = speed
@@ -32,6 +33,7 @@ class TestROMWriterTop(Elaboratable):
             init=rom.ROM_CONTENT,
         ).read_port()
         self.rom_writer = ROMWriter(addr=TestROMWriterTop.ADDR)
+        self.stop_monitor = sim_i2c.StopMonitor(self.i2c, self.rom_writer.busy)
 
     def elaborate(self, platform: Platform) -> Elaboratable:
         m = Module()
@@ -39,6 +41,7 @@ class TestROMWriterTop(Elaboratable):
         m.submodules.i2c = self.i2c
         m.submodules.rom_rd = self.rom_rd
         m.submodules.rom_writer = self.rom_writer
+        m.submodules.stop_monitor = self.stop_monitor
 
         connect(m, self.i2c.bus, self.rom_writer.i2c_bus)
         ROMBus.connect_read_port(m, self.rom_rd, self.rom_writer.rom_bus)
@@ -65,6 +68,8 @@ class TestROMWriter(sim.TestCase):
                 0xAE,
             ],
         )
+        yield from sim_i2c.check_stop(dut.stop_monitor)
+        assert not (yield dut.rom_writer.busy)
 
     @sim.i2c_speeds
     def test_sim_rom_writer_chara(self, dut: TestROMWriterTop) -> sim.Procedure:
@@ -91,3 +96,5 @@ class TestROMWriter(sim.TestCase):
                 0b00000000,
             ],
         )
+        yield from sim_i2c.check_stop(dut.stop_monitor)
+        assert not (yield dut.rom_writer.busy)
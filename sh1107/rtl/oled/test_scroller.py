@@ -21,6 +21,7 @@ class TestScrollerTop(Elaboratable):
     i2c: I2C
     rom_rd: ReadPort
     scroller: Scroller
+    stop_monitor: sim_i2c.StopMonitor
 
     def __init__(self, *, speed: Hz):
         self.speed = speed
@@ -32,6 +33,7 @@ class TestScrollerTop(Elaboratable):
             init=rom.ROM_CONTENT,
         ).read_port()
         self.scroller = Scroller(addr=TestScrollerTop.ADDR)
+        self.stop_monitor = sim_i2c.StopMonitor(self.i2c, self.scroller.busy)
 
     def elaborate(self, platform: Platform) -> Elaboratable:
         m = Module()
@@ -39,6 +41,7 @@ class TestScrollerTop(Elaboratable):
         m.submodules.i2c = self.i2c
         m.submodules.rom_rd = self.rom_rd
         m.submodules.scroller = self.scroller
+        m.submodules.stop_monitor = self.stop_monitor
 
         connect(m, self.i2c.bus, self.scroller.i2c_bus)
         ROMBus.connect_read_port(m, self.rom_rd, self.scroller.rom_bus)
@@ -86,3 +89,5 @@ class TestScroller(sim.TestCase):
             ],
             test_nacks=False,
         )
+        yield from sim_i2c.check_stop(dut.stop_monitor)
+        assert not (yield dut.scroller.busy)
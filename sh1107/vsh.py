@@ -1,22 +1,24 @@
+import hashlib
 import os
 import platform as pyplatform
+import shutil
 import subprocess
 from argparse import ArgumentParser, Namespace
 from enum import Enum
 from pathlib import Path
-from typing import cast
+from typing import Sequence, Union, cast
 
 from amaranth import Elaboratable, Signal
 from amaranth._toolchain.yosys import YosysBinary, find_yosys
 from amaranth.back import rtlil
 
 from . import rom
-from .base import path
+from .base import Blackbox, path
 from .build import build_top
 from .platform import Platform
 from .rtl.oled import OLED
 
-__all__ = ["add_main_arguments"]
+__all__ = ["add_main_arguments", "build", "vsh_arguments"]
 
 
 class _Optimize(Enum):
@@ -53,6 +55,48 @@ def add_main_arguments(parser: ArgumentParser):
         action="store_false",
         help="simulate the full SPI protocol for the flash reader; by default it is replaced with a blackbox for speed",
     )
+    parser.add_argument(
+        "--zig-i2c-decoder",
+        dest="i2c_whitebox",
+        action="store_false",
+        help="with -i, decode the I2C bus edge by edge in vsh, rather than in a C++ whitebox inside the design",
+    )
+    parser.add_argument(
+        "--explicit-stop",
+        action="store_true",
+        help="have the I2C blackbox end transactions when the user raises stop, rather than after a timeout",
+    )
+    parser.add_argument(
+        "--transaction-i2c",
+        action="store_true",
+        help="have the I2C blackbox accept writes immediately and hand them to the SH1107 in batches; bus timing is not modelled",
+    )
+    parser.add_argument(
+        "-B",
+        "--burst-spifr",
+        action="store_true",
+        help="have the flash reader blackbox present a byte every cycle, rather than every other",
+    )
+    parser.add_argument(
+        "--ticks-to-wait",
+        type=int,
+        help="cycles without FIFO activity before the I2C blackbox ends a transaction (1-16; default: 7)",
+    )
+    parser.add_argument(
+        "--byte-period",
+        type=int,
+        help="cycles between each byte from the flash reader blackbox (1-16; default: 2, or 1 with -B)",
+    )
+    parser.add_argument(
+        "--first-byte-latency",
+        type=int,
+        help="cycles from the flash reader blackbox being strobed to its first byte (default: the byte period)",
+    )
+    parser.add_argument(
+        "--continuous-read",
+        action="store_true",
+        help="have the flash reader blackbox carry on streaming without the first-byte latency when a read starts where the last one ended",
+    )
     parser.add_argument(
         "-c",
         "--compile",
@@ -78,6 +122,83 @@ def add_main_arguments(parser: ArgumentParser):
         action="store_true",
         help="output a VCD file",
     )
+    parser.add_argument(
+        "--vcd-from",
+        type=int,
+        help="only trace from this cycle onwards",
+    )
+    parser.add_argument(
+        "--vcd-to",
+        type=int,
+        help="only trace up to (but not including) this cycle",
+    )
+    parser.add_argument(
+        "--vcd-scope",
+        help="only trace signals whose names start with this (e.g. 'oled i2c')",
+    )
+    parser.add_argument(
+        "--rom",
+        type=Path,
+        help="map this flash image at startup instead of using the ROM built into vsh",
+    )
+    parser.add_argument(
+        "--headless",
+        action="store_true",
+        help="run without a window for --cycles cycles, then report simulation speed",
+    )
+    parser.add_argument(
+        "--cycles",
+        type=int,
+        help="number of cycles to run for in headless mode",
+    )
+    parser.add_argument(
+        "--press",
+        type=int,
+        help="press this switch (as numbered on the keyboard) at the start of a headless run",
+    )
+    parser.add_argument(
+        "--load-state",
+        type=Path,
+        help="start the simulation from this checkpoint, taken by --save-state with the same build",
+    )
+    parser.add_argument(
+        "--save-state",
+        type=Path,
+        help="with --headless, save a checkpoint once --cycles are up and the design is quiet",
+    )
+    parser.add_argument(
+        "--trace-latency",
+        action="store_true",
+        help="measure how many cycles each switch press takes to reach the I2C bus and the display, and report them as histograms",
+    )
+    parser.add_argument(
+        "--report",
+        type=Path,
+        help="write a JSON report of simulation speed and counters here when a headless or windowed run ends",
+    )
+    parser.add_argument(
+        "--run",
+        metavar="SCRIPT",
+        type=Path,
+        action="append",
+        help="run a stimulus script headless and report its final framebuffer; may be given multiple times, and the scripts are run in parallel",
+    )
+    parser.add_argument(
+        "-j",
+        "--jobs",
+        type=int,
+        help="number of scripts to run at once (default: one per CPU)",
+    )
+    parser.add_argument(
+        "--bless",
+        action="store_true",
+        help="don't check scripts' expects; print ones matching this run instead",
+    )
+    parser.add_argument(
+        "--fb-out",
+        type=Path,
+        help="write each script's final framebuffer to this directory",
+    )
     parser.add_argument(
         "-O",
         "--optimize",
@@ -86,9 +207,34 @@ def add_main_arguments(parser: ArgumentParser):
         help="build RTL or Zig with optimizations (default: both)",
         default=_Optimize.both,
     )
+    parser.add_argument(
+        "--pgo",
+        type=int,
+        metavar="CYCLES",
+        help="compile the design and blackboxes as one unit, profile CYCLES headless cycles of it, and rebuild using the profile (needs llvm-profdata and clang's profile runtime matching zig's LLVM)",
+    )
 
 
 def main(args: Namespace):
+    if args.headless and args.cycles is None:
+        raise SystemExit("--headless requires --cycles")
+    if args.save_state is not None and (not args.headless or args.run):
+        raise SystemExit("--save-state requires --headless, and can't be used with --run")
+    if args.pgo is not None and not args.optimize.opt_rtl:
+        raise SystemExit("--pgo requires -O rtl or -O both")
+
+    cmd = build(args)
+    if not args.compile:
+        cmd += ["run", "--", *vsh_arguments(args)]
+    subprocess.run(cmd, cwd=path("vsh"), check=True)
+
+
+def build(args: Namespace) -> list[str]:
+    """
+    Builds the design and blackboxes selected by args, and returns the `zig
+    build` command line (to be run in vsh/) that compiles vsh against them.
+    The caller appends any steps and runs it.
+    """
     if (
         os.environ.get("VIRTUAL_ENV") == "OSS Cad Suite"
         and pyplatform.system() == "Windows"
@@ -101,12 +247,37 @@ def main(args: Namespace):
     yosys = cast(YosysBinary, find_yosys(lambda ver: ver >= (0, 10)))
 
     platform = Platform["vsh"]
+    i2c_parameters: dict[str, int] = {}
+    if args.explicit_stop:
+        i2c_parameters["EXPLICIT_STOP"] = 1
+    if args.ticks_to_wait is not None:
+        i2c_parameters["TICKS_TO_WAIT"] = args.ticks_to_wait
+    if args.transaction_i2c:
+        i2c_parameters["TRANSACTION_LEVEL"] = 1
+    spifr_parameters: dict[str, int] = {}
+    if args.byte_period is not None:
+        spifr_parameters["BYTE_PERIOD"] = args.byte_period
+    elif args.burst_spifr:
+        spifr_parameters["BYTE_PERIOD"] = 1
+    if args.first_byte_latency is not None:
+        spifr_parameters["FIRST_BYTE_LATENCY"] = args.first_byte_latency
+    if args.continuous_read:
+        spifr_parameters["CONTINUOUS_READ"] = 1
+
+    platform.blackbox_parameters = {}
+    if args.blackbox_i2c:
+        platform.blackbox_parameters[Blackbox.I2C] = i2c_parameters
+    if args.blackbox_spifr:
+        platform.blackbox_parameters[Blackbox.SPIFR] = spifr_parameters
     design = build_top(args, platform)
 
     black_boxes = {}
     if args.blackbox_i2c:
         with open(path("vsh/i2c_blackbox.il"), "r") as f:
             black_boxes["i2c"] = f.read()
+    elif args.i2c_whitebox:
+        with open(path("vsh/i2c_whitebox.il"), "r") as f:
+            black_boxes["i2c_whitebox"] = f.read()
     if args.blackbox_spifr:
         with open(path("vsh/spifr_blackbox.il"), "r") as f:
             black_boxes["spifr"] = f.read()
@@ -124,49 +295,208 @@ def main(args: Namespace):
         ports=design.ports(platform),
     )
 
-    cc_o_paths = {cxxrtl_cc_path: cxxrtl_cc_path.with_suffix(".o")}
+    cc_o_paths = {
+        cxxrtl_cc_path: cxxrtl_cc_path.with_suffix(".o"),
+        path("vsh/blackbox.cc"): path("build/blackbox.o"),
+        path("vsh/sh1107_model.cc"): path("build/sh1107_model.o"),
+    }
     if args.blackbox_i2c:
         cc_o_paths[path("vsh/i2c_blackbox.cc")] = path("build/i2c_blackbox.o")
+    elif args.i2c_whitebox:
+        cc_o_paths[path("vsh/i2c_whitebox.cc")] = path("build/i2c_whitebox.o")
     if args.blackbox_spifr:
         cc_o_paths[path("vsh/spifr_blackbox.cc")] = path("build/spifr_blackbox.o")
     else:
         cc_o_paths[path("vsh/spifr_whitebox.cc")] = path("build/spifr_whitebox.o")
 
-    for cc_path, o_path in cc_o_paths.items():
-        subprocess.run(
-            [
-                "zig",
-                "c++",
-                *(["-O3"] if args.optimize.opt_rtl else []),
-                "-DCXXRTL_INCLUDE_CAPI_IMPL",
-                "-DCXXRTL_INCLUDE_VCD_CAPI_IMPL",
-                "-I" + str(path(".")),
-                "-I" + str(cast(Path, yosys.data_dir()) / "include" / "backends" / "cxxrtl" / "runtime"),
-                "-c",
-                cc_path,
-                "-o",
-                o_path,
-            ],
-            check=True,
-        )
-
     with open(path("vsh/src/rom.bin"), "wb") as f:
         f.write(rom.ROM_CONTENT)
 
-    cmd: list[str] = ["zig", "build"]
-    if not args.compile:
-        cmd += ["run"]
-    cmd += [
+    if args.pgo is None:
+        for cc_path, o_path in cc_o_paths.items():
+            _compile_cc(yosys, args, cc_path, o_path, cache=True)
+        o_paths = list(cc_o_paths.values())
+    else:
+        o_paths = _build_pgo(yosys, args, list(cc_o_paths))
+
+    return _zig_build(yosys, args, o_paths)
+
+
+def _compile_cc(
+    yosys: YosysBinary,
+    args: Namespace,
+    cc_path: Path,
+    o_path: Path,
+    extra: Sequence[str] = (),
+    *,
+    cache: bool = False,
+) -> None:
+    """
+    With cache set, o_path is left be if it was last compiled from the same
+    source, the same headers of ours and the design's, and the same command.
+    """
+    cmd = [
+        "zig",
+        "c++",
+        *(["-O3"] if args.optimize.opt_rtl else []),
+        *extra,
+        "-DCXXRTL_INCLUDE_CAPI_IMPL",
+        "-DCXXRTL_INCLUDE_VCD_CAPI_IMPL",
+        "-I" + str(path(".")),
+        "-I" + str(cast(Path, yosys.data_dir()) / "include" / "backends" / "cxxrtl" / "runtime"),
+        "-c",
+        str(cc_path),
+        "-o",
+        str(o_path),
+    ]
+
+    key_path = o_path.with_name(o_path.name + ".key")
+    if cache:
+        headers = [*sorted(path("vsh").glob("*.h")), path("build/sh1107.h")]
+        key = _cache_key(
+            str(yosys.version()),
+            *cmd,
+            cc_path.read_bytes(),
+            *(header.read_bytes() for header in headers),
+        )
+        if _cache_hit(key_path, key, [o_path]):
+            return
+    key_path.unlink(missing_ok=True)
+
+    subprocess.run(cmd, check=True)
+    if cache:
+        key_path.write_text(key)
+
+
+def _cache_key(*parts: Union[str, bytes]) -> str:
+    h = hashlib.sha256()
+    for part in parts:
+        data = part.encode() if isinstance(part, str) else part
+        h.update(len(data).to_bytes(8, "little"))
+        h.update(data)
+    return h.hexdigest()
+
+
+def _cache_hit(key_path: Path, key: str, outputs: list[Path]) -> bool:
+    try:
+        return key_path.read_text() == key and all(o.exists() for o in outputs)
+    except FileNotFoundError:
+        return False
+
+
+def _zig_build(yosys: YosysBinary, args: Namespace, o_paths: list[Path]) -> list[str]:
+    return [
+        "zig",
+        "build",
         *(["-Doptimize=ReleaseFast"] if args.optimize.opt_zig else []),
         f"-Dyosys_data_dir={yosys.data_dir()}",
-        f"-Dcxxrtl_lib_paths={','.join(str(o_path) for o_path in cc_o_paths.values())}",
+        f"-Dcxxrtl_lib_paths={','.join(str(o_path) for o_path in o_paths)}",
     ]
-    if not args.compile:
-        cmd += ["--"]
-        if args.vcd:
-            cmd += ["--vcd"]
 
-    subprocess.run(cmd, cwd=path("vsh"), check=True)
+
+def _build_pgo(yosys: YosysBinary, args: Namespace, cc_paths: list[Path]) -> list[Path]:
+    """
+    Compiles cc_paths as a single translation unit, so the blackboxes' evals
+    can be inlined into the design's, then optimises it with a profile of
+    args.pgo headless cycles of an instrumented build.  The profile's what
+    lets the compiler see which cell each indirect eval call usually goes to.
+    """
+    profdata_tool = shutil.which("llvm-profdata")
+    if profdata_tool is None:
+        raise SystemExit("--pgo requires llvm-profdata on PATH")
+    runtime = _profile_runtime()
+
+    unity_path = path("build/vsh_unity.cc")
+    with open(unity_path, "w") as f:
+        for cc_path in cc_paths:
+            f.write(f'#include "{cc_path.absolute().as_posix()}"\n')
+    o_path = unity_path.with_suffix(".o")
+
+    raw_dir = path("build/pgo")
+    shutil.rmtree(raw_dir, ignore_errors=True)
+    raw_dir.mkdir(parents=True)
+
+    _compile_cc(yosys, args, unity_path, o_path, ["-fprofile-instr-generate"])
+    profile_args = Namespace(
+        **{
+            **vars(args),
+            "headless": True,
+            "cycles": args.pgo,
+            "run": None,
+            "vcd": False,
+            "save_state": None,
+        }
+    )
+    subprocess.run(
+        [*_zig_build(yosys, args, [o_path, runtime]), "run", "--", *vsh_arguments(profile_args)],
+        cwd=path("vsh"),
+        env={**os.environ, "LLVM_PROFILE_FILE": str(raw_dir / "%p.profraw")},
+        check=True,
+    )
+
+    profdata = path("build/vsh.profdata")
+    subprocess.run(
+        [profdata_tool, "merge", "-o", profdata, *sorted(raw_dir.glob("*.profraw"))],
+        check=True,
+    )
+    _compile_cc(yosys, args, unity_path, o_path, [f"-fprofile-instr-use={profdata}"])
+    return [o_path]
+
+
+def _profile_runtime() -> Path:
+    # Zig doesn't ship compiler-rt's profile runtime, so we borrow clang's.
+    clang = shutil.which("clang")
+    if clang is not None:
+        runtime_dir = subprocess.run(
+            [clang, "-print-runtime-dir"], capture_output=True, text=True, check=True
+        ).stdout.strip()
+        for candidate in sorted(Path(runtime_dir).glob("libclang_rt.profile*.a")):
+            return candidate
+    raise SystemExit("--pgo requires clang's profile runtime (libclang_rt.profile)")
+
+
+def vsh_arguments(args: Namespace) -> list[str]:
+    # The clock lets vsh pace the simulation to real time while the design is
+    # idle; with the bus speed too, it only decodes the bus as often as it can
+    # change.
+    cmd: list[str] = [
+        "--clk-hz",
+        str(Platform["vsh"].default_clk_frequency),
+        "--i2c-hz",
+        str(args.speed),
+    ]
+    if args.rom is not None:
+        cmd += ["--rom", str(args.rom.absolute())]
+    if args.load_state is not None:
+        cmd += ["--load-state", str(args.load_state.absolute())]
+    if args.trace_latency:
+        cmd += ["--trace-latency"]
+    if args.report is not None:
+        cmd += ["--report", str(args.report.absolute())]
+    if args.vcd:
+        cmd += ["--vcd"]
+        if args.vcd_from is not None:
+            cmd += ["--vcd-from", str(args.vcd_from)]
+        if args.vcd_to is not None:
+            cmd += ["--vcd-to", str(args.vcd_to)]
+        if args.vcd_scope is not None:
+            cmd += ["--vcd-scope", args.vcd_scope]
+    if args.run:
+        for script in args.run:
+            cmd += ["--run", str(script.absolute())]
+        if args.jobs is not None:
+            cmd += ["--jobs", str(args.jobs)]
+        if args.fb_out is not None:
+            cmd += ["--fb-out", str(args.fb_out.absolute())]
+        if args.bless:
+            cmd += ["--bless"]
+    elif args.headless:
+        cmd += ["--headless", "--cycles", str(args.cycles)]
+        if args.press is not None:
+            cmd += ["--press", str(args.press)]
+        if args.save_state is not None:
+            cmd += ["--save-state", str(args.save_state.absolute())]
+    return cmd
 
 
 def _cxxrtl_convert_with_header(
@@ -191,4 +521,15 @@ def _cxxrtl_convert_with_header(
         script.append(f"read_rtlil <<rtlil\n{box_source}\nrtlil")
     script.append(f"read_rtlil <<rtlil\n{rtlil_text}\nrtlil")
     script.append(f"write_cxxrtl -header {cc_out}")
-    yosys.run(["-q", "-"], "\n".join(script))
+    script_text = "\n".join(script)
+
+    # The design only changes when the RTLIL or the blackboxes' interfaces do,
+    # so don't run yosys again if they haven't.
+    key_path = cc_out.with_name(cc_out.name + ".key")
+    key = _cache_key(str(yosys.version()), script_text)
+    if _cache_hit(key_path, key, [cc_out, cc_out.with_suffix(".h")]):
+        return
+    key_path.unlink(missing_ok=True)
+
+    yosys.run(["-q", "-"], script_text)
+    key_path.write_text(key)
@@ -0,0 +1,218 @@
+#include "vsh/blackbox.h"
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <tuple>
+
+namespace vsh {
+
+namespace {
+
+std::mutex registry_mutex;
+std::vector<const stats *> registry;
+
+std::atomic<uint64_t> next_design{1u};
+thread_local uint64_t current_design = 0u;
+
+std::mutex stateful_mutex;
+std::vector<stateful *> statefuls;
+
+// Appends s as a JSON string.
+void json_string(std::string &out, std::string_view s) {
+  static constexpr char hex[] = "0123456789abcdef";
+
+  out += '"';
+  for (char c : s) {
+    if (c == '"' || c == '\\') {
+      out += '\\';
+      out += c;
+    } else if (static_cast<unsigned char>(c) < 0x20u) {
+      out += "\\u00";
+      out += hex[(c >> 4) & 0xf];
+      out += hex[c & 0xf];
+    } else {
+      out += c;
+    }
+  }
+  out += '"';
+}
+
+// Copies out into buf, NUL-terminated and truncated to fit, and returns the
+// length of the whole thing.
+size_t copy_out(const std::string &out, char *buf, size_t size) {
+  if (size > 0) {
+    size_t n = std::min(out.size(), size - 1);
+    std::memcpy(buf, out.data(), n);
+    buf[n] = '\0';
+  }
+  return out.size();
+}
+
+} // namespace
+
+flash flash::current() {
+  static std::mutex mutex;
+  static std::vector<
+      std::pair<std::tuple<const uint8_t *, uint32_t, uint32_t>,
+                std::weak_ptr<const std::vector<uint8_t>>>>
+      parts;
+
+  uint32_t base = spi_flash_base & (CAPACITY - 1u);
+  // Whatever would hang off the top of the part isn't on it.
+  uint32_t length = std::min(spi_flash_length, CAPACITY - base);
+  auto key = std::make_tuple(spi_flash_content, base, length);
+
+  std::lock_guard<std::mutex> lock(mutex);
+  parts.erase(std::remove_if(parts.begin(), parts.end(),
+                             [](const auto &p) { return p.second.expired(); }),
+              parts.end());
+  // A live entry's image is still in use, so still mapped: nothing else can
+  // have turned up at its address since.
+  for (const auto &p : parts)
+    if (p.first == key)
+      if (auto part = p.second.lock())
+        return {part, part->data()};
+
+  auto part = std::make_shared<std::vector<uint8_t>>(CAPACITY, 0xffu);
+  std::copy_n(spi_flash_content, length, part->begin() + base);
+  parts.emplace_back(key, part);
+  return {part, part->data()};
+}
+
+stats::stats(
+    std::string name,
+    std::initializer_list<std::pair<const char *, const counter *>> counters)
+    : name(std::move(name)), counters(counters) {
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  registry.push_back(this);
+}
+
+stats::~stats() {
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  registry.erase(std::remove(registry.begin(), registry.end(), this),
+                 registry.end());
+}
+
+void stats::format(std::string &out) const {
+  out += this->name;
+  out += ":";
+  for (auto &[counter_name, counter] : this->counters) {
+    out += " ";
+    out += counter_name;
+    out += " ";
+    out += std::to_string(counter->get());
+  }
+  out += "\n";
+}
+
+void stats::format_json(std::string &out) const {
+  out += "{\"name\":";
+  json_string(out, this->name);
+  out += ",\"counters\":{";
+  bool first = true;
+  for (auto &[counter_name, counter] : this->counters) {
+    if (!first)
+      out += ",";
+    first = false;
+    json_string(out, counter_name);
+    out += ":";
+    out += std::to_string(counter->get());
+  }
+  out += "}}";
+}
+
+stateful::stateful(std::string name)
+    : name(std::move(name)), design(current_design) {
+  std::lock_guard<std::mutex> lock(stateful_mutex);
+  statefuls.push_back(this);
+}
+
+stateful::~stateful() {
+  std::lock_guard<std::mutex> lock(stateful_mutex);
+  statefuls.erase(std::remove(statefuls.begin(), statefuls.end(), this),
+                  statefuls.end());
+}
+
+} // namespace vsh
+
+extern "C" size_t vsh_stats_format(char *buf, size_t size) {
+  std::string out;
+  {
+    std::lock_guard<std::mutex> lock(vsh::registry_mutex);
+    for (auto *stats : vsh::registry)
+      stats->format(out);
+  }
+  return vsh::copy_out(out, buf, size);
+}
+
+extern "C" size_t vsh_stats_format_json(char *buf, size_t size) {
+  std::string out = "[";
+  {
+    std::lock_guard<std::mutex> lock(vsh::registry_mutex);
+    bool first = true;
+    for (auto *stats : vsh::registry) {
+      if (!first)
+        out += ",";
+      first = false;
+      stats->format_json(out);
+    }
+  }
+  out += "]";
+  return vsh::copy_out(out, buf, size);
+}
+
+extern "C" uint64_t vsh_design_begin(void) {
+  vsh::current_design = vsh::next_design.fetch_add(1u);
+  return vsh::current_design;
+}
+
+// Each stateful is saved as its name and then what it wrote, both prefixed
+// with their length, in the order they were created.
+extern "C" size_t vsh_blackbox_save(uint64_t design, char *buf, size_t size) {
+  std::string out;
+  {
+    std::lock_guard<std::mutex> lock(vsh::stateful_mutex);
+    for (auto *stateful : vsh::statefuls) {
+      if (stateful->design != design)
+        continue;
+
+      std::string state;
+      stateful->save(state);
+      vsh::put(out, uint32_t(stateful->name.size()));
+      out += stateful->name;
+      vsh::put(out, uint32_t(state.size()));
+      out += state;
+    }
+  }
+
+  if (out.size() <= size)
+    std::memcpy(buf, out.data(), out.size());
+  return out.size();
+}
+
+extern "C" bool vsh_blackbox_restore(uint64_t design, const char *buf,
+                                     size_t size) {
+  std::string_view in(buf, size);
+
+  std::lock_guard<std::mutex> lock(vsh::stateful_mutex);
+  for (auto *stateful : vsh::statefuls) {
+    if (stateful->design != design)
+      continue;
+
+    uint32_t name_len, state_len;
+    if (!vsh::get(in, name_len) || in.size() < name_len ||
+        in.substr(0, name_len) != stateful->name)
+      return false;
+    in.remove_prefix(name_len);
+    if (!vsh::get(in, state_len) || in.size() < state_len)
+      return false;
+
+    std::string_view state = in.substr(0, state_len);
+    in.remove_prefix(state_len);
+    if (!stateful->restore(state) || !state.empty())
+      return false;
+  }
+
+  return in.empty();
+}
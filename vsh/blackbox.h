@@ -0,0 +1,190 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <cxxrtl/cxxrtl.h>
+
+/**
+ * Bits and pieces shared between the blackboxes.
+ */
+
+extern "C" const uint8_t *spi_flash_content;
+extern "C" uint32_t spi_flash_base;
+extern "C" uint32_t spi_flash_length;
+
+// Writes a line per live vsh::stats into buf, NUL-terminated and truncated to
+// fit.  Returns the length the whole thing would have been, as snprintf does.
+extern "C" size_t vsh_stats_format(char *buf, size_t size);
+
+// As vsh_stats_format, but as a JSON array with an object per vsh::stats:
+// {"name": ..., "counters": {...}}.  Two may share a name.
+extern "C" size_t vsh_stats_format_json(char *buf, size_t size);
+
+// Starts a new design: every vsh::stateful constructed on this thread from now
+// until the next call belongs to it.  Call just before cxxrtl_design_create.
+extern "C" uint64_t vsh_design_begin(void);
+
+// Writes the state of the design's blackboxes into buf, returning the length
+// it needed; if that's more than size, nothing useful was written.
+extern "C" size_t vsh_blackbox_save(uint64_t design, char *buf, size_t size);
+
+// Restores what vsh_blackbox_save wrote.  Returns false if it doesn't match
+// the design's blackboxes, in which case some may have been restored already.
+extern "C" bool vsh_blackbox_restore(uint64_t design, const char *buf,
+                                     size_t size);
+
+namespace vsh {
+
+// The flash image the SPI flash blackboxes read from (see vsh/src/main.zig),
+// laid out as the 16 MiB part a READ's 24 address bits can reach: the image at
+// base, erased (0xff) everywhere else.  Like the real thing, addresses past
+// the top alias back round to the bottom, so a read is just a mask.
+//
+// Each blackbox takes a copy when it's created, so designs created one after
+// another against different images keep their own.  The part is built once per
+// image and shared by every design created from it while any is alive.
+struct flash {
+  static constexpr uint32_t CAPACITY = 1u << 24;
+
+  std::shared_ptr<const std::vector<uint8_t>> part;
+  const uint8_t *content;
+
+  static flash current();
+
+  uint8_t read(uint32_t addr) const { return content[addr & (CAPACITY - 1u)]; }
+};
+
+// Cell parameters come through as UINT or SINT depending on how the frontend
+// chose to emit them, and may be missing altogether if the instantiating cell
+// didn't set them.  We only deal in small non-negative integers.
+inline uint64_t parameter_uint(const std::string &name,
+                               const cxxrtl::metadata_map &parameters,
+                               const std::string &parameter,
+                               uint64_t fallback) {
+  auto it = parameters.find(parameter);
+  if (it == parameters.end())
+    return fallback;
+
+  switch (it->second.value_type) {
+  case cxxrtl::metadata::UINT:
+    return it->second.as_uint();
+  case cxxrtl::metadata::SINT:
+    if (it->second.as_sint() >= 0)
+      return static_cast<uint64_t>(it->second.as_sint());
+    break;
+  default:
+    break;
+  }
+
+  std::cerr << name << ": ignoring bad value for parameter " << parameter
+            << std::endl;
+  return fallback;
+}
+
+// Calls f with a std::integral_constant for value, which must be in [MIN, MAX],
+// so a blackbox can be instantiated with its timing folded into the code.
+template <typename T, T MIN, T MAX, typename F>
+auto specialise(T value, F &&f) {
+  if constexpr (MIN == MAX) {
+    return f(std::integral_constant<T, MIN>{});
+  } else {
+    if (value == MIN)
+      return f(std::integral_constant<T, MIN>{});
+    return specialise<T, MIN + 1, MAX>(value, std::forward<F>(f));
+  }
+}
+
+// A counter that's only ever bumped from the simulation thread, but may be read
+// from any.  Relaxed loads and stores are enough for that, and don't cost us a
+// locked instruction per bump.
+class counter {
+public:
+  void operator++() { *this += 1u; }
+  void operator+=(uint64_t n) {
+    value.store(value.load(std::memory_order_relaxed) + n,
+                std::memory_order_relaxed);
+  }
+  uint64_t get() const { return value.load(std::memory_order_relaxed); }
+
+private:
+  std::atomic<uint64_t> value{0u};
+};
+
+// A named set of counters, listed by vsh_stats_format() for as long as it
+// lives.  Declare it after the counters it refers to.
+class stats {
+public:
+  stats(std::string name,
+        std::initializer_list<std::pair<const char *, const counter *>>
+            counters);
+  ~stats();
+
+  stats(const stats &) = delete;
+  stats &operator=(const stats &) = delete;
+
+  void format(std::string &out) const;
+  void format_json(std::string &out) const;
+
+private:
+  std::string name;
+  std::vector<std::pair<const char *, const counter *>> counters;
+};
+
+// Blackbox state that vsh can carry across a checkpoint, along with the
+// design's own.  Only what isn't rebuilt by the next eval needs saving: member
+// state, and the curr of any output wires.
+class stateful {
+public:
+  explicit stateful(std::string name);
+  virtual ~stateful();
+
+  stateful(const stateful &) = delete;
+  stateful &operator=(const stateful &) = delete;
+
+  virtual void save(std::string &out) const = 0;
+  // Returns false if in isn't what save wrote.  Must consume all of in.
+  virtual bool restore(std::string_view &in) = 0;
+
+  const std::string name;
+  const uint64_t design;
+};
+
+// Helpers for stateful::save/restore.  Plain data is copied as-is; we only
+// ever restore into the same build on the same machine.
+template <typename T> void put(std::string &out, const T &v) {
+  static_assert(std::is_trivially_copyable_v<T>);
+  out.append(reinterpret_cast<const char *>(&v), sizeof(v));
+}
+
+template <typename T> bool get(std::string_view &in, T &v) {
+  static_assert(std::is_trivially_copyable_v<T>);
+  if (in.size() < sizeof(v))
+    return false;
+  std::memcpy(&v, in.data(), sizeof(v));
+  in.remove_prefix(sizeof(v));
+  return true;
+}
+
+template <size_t Bits>
+void put(std::string &out, const cxxrtl::wire<Bits> &w) {
+  put(out, w.curr);
+}
+
+template <size_t Bits> bool get(std::string_view &in, cxxrtl::wire<Bits> &w) {
+  if (!get(in, w.curr))
+    return false;
+  w.next = w.curr;
+  return true;
+}
+
+} // namespace vsh
@@ -43,6 +43,17 @@ pub fn build(b: *std.Build) void {
     const run_unit_tests = b.addRunArtifact(unit_tests);
     const test_step = b.step("test", "Run unit tests");
     test_step.dependOn(&run_unit_tests.step);
+
+    // Modules that stand alone get their own, so they can be tested without
+    // the design and GameKit that main needs.
+    for ([_][]const u8{"src/Script.zig"}) |path| {
+        const module_tests = b.addTest(.{
+            .root_source_file = .{ .path = path },
+            .target = target,
+            .optimize = optimize,
+        });
+        test_step.dependOn(&b.addRunArtifact(module_tests).step);
+    }
 }
 
 fn guessYosysDataDir(b: *std.Build) []const u8 {
@@ -1,42 +1,73 @@
 #include "build/sh1107.h"
+#include "vsh/blackbox.h"
+#include "vsh/sh1107_model.h"
 #include <iostream>
+#include <vector>
 
 /**
  * This code is officially Not Poggers(tm).
  *
  * We emulate the external interface of i2c.py's I2C module for the benefit of
- * the rest of the design, rather than the benefit of the simulation.  The
- * simulation snoops _our inputs_ and uses those directly.
+ * the rest of the design, rather than the benefit of the simulation.  What's
+ * written for the device at ADDR goes straight to our SH1107 model.
  */
 
 namespace cxxrtl_design {
 
-struct bb_p_i2c_impl : public bb_p_i2c {
-  // NOTE(Ch): Wow! This is a very magic number! This specifies how many
-  // posedges without FIFO activity to wait until we consider the transaction to
-  // be done and bring "busy" low.  Whether this is sufficient will vary
-  // depending on the users of the real I2C module, and how much leeway it gives
-  // its users.  We might want to consider a rewrite where transaction ends are
-  // signalled explicitly from the user, but that gets Fucky Wucky if they don't
-  // actually give input data in time for the I2C bus.
-  //
-  // 5 is sufficient for a tight loop, but when e.g. ROMWriter/Scroller do a
-  // repeated start, they spend a few cycles while reading the length of the
-  // next segment, and when it's non-zero, we need to wait a little more.
-  const uint16_t TICKS_TO_WAIT = 7u;
+// NOTE(Ch): Wow! TICKS_TO_WAIT is a very magic number! This specifies how
+// many posedges without FIFO activity to wait until we consider the
+// transaction to be done and bring "busy" low.  Whether this is sufficient
+// will vary depending on the users of the real I2C module, and how much leeway
+// it gives its users.  We might want to consider a rewrite where transaction
+// ends are signalled explicitly from the user, but that gets Fucky Wucky if
+// they don't actually give input data in time for the I2C bus.
+//
+// 5 is sufficient for a tight loop, but when e.g. ROMWriter/Scroller do a
+// repeated start, they spend a few cycles while reading the length of the
+// next segment, and when it's non-zero, we need to wait a little more.  The
+// TICKS_TO_WAIT parameter defaults to 7 for that reason.
+//
+// With EXPLICIT_STOP set, we ignore the above and instead end the
+// transaction once the user has raised stop and the FIFO's drained.  All the
+// users in the design do this, but the real I2C module doesn't care, so
+// there's nothing much keeping them honest.
+//
+// TRANSACTION_LEVEL goes further, for soak tests that only care what bytes
+// the design sends: it doesn't model bus timing at all.  Every FIFO write is
+// accepted the cycle it's made (w_rdy never falls), transactions end on stop
+// as with EXPLICIT_STOP, and what's written to the SH1107 is handed over in
+// batches rather than byte by byte.  busy still stays high from stb to stop;
+// ROMWriter and Scroller take it falling mid-transaction as a failure.
+template <uint16_t TICKS_TO_WAIT, bool EXPLICIT_STOP, bool TRANSACTION_LEVEL>
+struct bb_p_i2c_impl : public bb_p_i2c, public vsh::stateful {
+  // Should match I2C.IN_FIFO_DEPTH.  We don't spend any time on the bus, so a
+  // byte is taken off the FIFO on the same edge it's written while busy; the
+  // depth only matters for what gets queued up before stb.
+  const size_t IN_FIFO_DEPTH;
+  const uint8_t ADDR;
+
+  bb_p_i2c_impl(std::string name, size_t in_fifo_depth, uint8_t addr)
+      : vsh::stateful(name), IN_FIFO_DEPTH(in_fifo_depth), ADDR(addr),
+        in_fifo(in_fifo_depth), sh1107(name + " sh1107"),
+        stats(std::move(name), {
+                                   {"transactions", &transactions},
+                                   {"bytes", &bytes},
+                                   {"stalls", &stalls},
+                                   {"dropped", &dropped},
+                                   {"busy", &busy_cycles},
+                                   {"idle", &idle_cycles},
+                               }) {}
 
   enum {
     STATE_IDLE,
     STATE_BUSY,
   } state;
 
-  uint16_t ticks_until_done;
+  uint16_t ticks_until_done = 0u;
 
-  enum {
-    IN_FIFO_STATE_EMPTY,
-    IN_FIFO_STATE_FULL,
-  } in_fifo_state;
-  uint16_t in_fifo_value;
+  std::vector<uint16_t> in_fifo;
+  size_t in_fifo_head;
+  size_t in_fifo_level;
 
   enum {
     OUT_FIFO_STATE_EMPTY,
@@ -44,12 +75,34 @@ struct bb_p_i2c_impl : public bb_p_i2c {
   } out_fifo_state;
   uint8_t out_fifo_value;
 
+  // Whether the transaction's addressed to the SH1107, and which way.
+  enum {
+    ADDRESSED_NONE,
+    ADDRESSED_WRITE,
+    ADDRESSED_READ,
+  } addressed;
+  bool ack;
+  vsh::sh1107 sh1107;
+
+  // With TRANSACTION_LEVEL, bytes for the SH1107 not yet handed over.
+  static constexpr size_t BATCH_BYTES = 256u;
+  uint8_t batch[BATCH_BYTES] = {};
+  size_t batch_len;
+
+  // Kept across resets.  A stall is a cycle spent with the in FIFO full.
+  vsh::counter transactions, bytes, stalls, dropped, busy_cycles, idle_cycles;
+  vsh::stats stats;
+
   void reset() override {
     this->state = STATE_IDLE;
-    this->in_fifo_state = IN_FIFO_STATE_EMPTY;
-    this->in_fifo_value = 0u;
+    this->ticks_until_done = 0u;
+    this->in_fifo_head = 0u;
+    this->in_fifo_level = 0u;
     this->out_fifo_state = OUT_FIFO_STATE_EMPTY;
     this->out_fifo_value = 0u;
+    this->addressed = ADDRESSED_NONE;
+    this->ack = true;
+    this->batch_len = 0u;
 
     p_busy = wire<1>{0u};
     p_ack = wire<1>{1u};
@@ -58,76 +111,222 @@ struct bb_p_i2c_impl : public bb_p_i2c {
     p_out__fifo__r__data = wire<8>{0u};
   }
 
+  void save(std::string &out) const override {
+    vsh::put(out, this->state);
+    vsh::put(out, this->ticks_until_done);
+    for (uint16_t entry : this->in_fifo)
+      vsh::put(out, entry);
+    vsh::put(out, this->in_fifo_head);
+    vsh::put(out, this->in_fifo_level);
+    vsh::put(out, this->out_fifo_state);
+    vsh::put(out, this->out_fifo_value);
+    vsh::put(out, this->addressed);
+    vsh::put(out, this->ack);
+    vsh::put(out, this->batch);
+    vsh::put(out, this->batch_len);
+    vsh::put(out, p_busy);
+    vsh::put(out, p_ack);
+    vsh::put(out, p_in__fifo__w__rdy);
+    vsh::put(out, p_out__fifo__r__rdy);
+    vsh::put(out, p_out__fifo__r__data);
+  }
+
+  bool restore(std::string_view &in) override {
+    bool ok = vsh::get(in, this->state) &&
+              vsh::get(in, this->ticks_until_done);
+    for (uint16_t &entry : this->in_fifo)
+      ok = ok && vsh::get(in, entry);
+    return ok && vsh::get(in, this->in_fifo_head) &&
+           vsh::get(in, this->in_fifo_level) &&
+           this->in_fifo_head < IN_FIFO_DEPTH &&
+           this->in_fifo_level <= IN_FIFO_DEPTH &&
+           vsh::get(in, this->out_fifo_state) &&
+           vsh::get(in, this->out_fifo_value) &&
+           vsh::get(in, this->addressed) && vsh::get(in, this->ack) &&
+           vsh::get(in, this->batch) && vsh::get(in, this->batch_len) &&
+           this->batch_len <= BATCH_BYTES && vsh::get(in, p_busy) &&
+           vsh::get(in, p_ack) && vsh::get(in, p_in__fifo__w__rdy) &&
+           vsh::get(in, p_out__fifo__r__rdy) &&
+           vsh::get(in, p_out__fifo__r__data);
+  }
+
   bool eval(performer *performer) override {
     bool converged = true;
     bool posedge_p_clk = this->posedge_p_clk();
 
     if (posedge_p_clk) {
-      p_ack.next = p_bb__in__ack;
+      p_ack.next = value<1>{this->ack ? 1u : 0u};
 
       if (p_out__fifo__r__en && out_fifo_state == OUT_FIFO_STATE_FULL) {
         out_fifo_state = OUT_FIFO_STATE_EMPTY;
         p_out__fifo__r__rdy.next = value<1>{0u};
       }
 
-      if (p_bb__in__out__fifo__stb) {
-        out_fifo_state = OUT_FIFO_STATE_FULL;
-        out_fifo_value = p_bb__in__out__fifo__data.get<uint8_t>();
-        p_out__fifo__r__rdy.next = value<1>{1u};
-        p_out__fifo__r__data.next = value<8>{out_fifo_value};
+      if (p_in__fifo__w__en) {
+        if constexpr (TRANSACTION_LEVEL) {
+          ++this->bytes;
+          this->snoop(p_in__fifo__w__data.get<uint16_t>());
+        } else if (this->in_fifo_level < IN_FIFO_DEPTH) {
+          this->snoop(p_in__fifo__w__data.get<uint16_t>());
+          this->in_fifo[(this->in_fifo_head + this->in_fifo_level) %
+                        IN_FIFO_DEPTH] = p_in__fifo__w__data.get<uint16_t>();
+          ++this->in_fifo_level;
+        } else {
+          ++this->dropped;
+          std::cerr << "bb_p_i2c_impl: dropping a write: " << std::hex << "0x"
+                    << p_in__fifo__w__data.get<uint16_t>() << std::endl;
+        }
       }
 
       switch (this->state) {
       case STATE_IDLE: {
+        ++this->idle_cycles;
         if (p_stb) {
           p_busy.next = value<1>{1u};
           this->state = STATE_BUSY;
           this->ticks_until_done = TICKS_TO_WAIT;
+          ++this->transactions;
         }
         break;
       }
       case STATE_BUSY: {
-        if (this->in_fifo_state == IN_FIFO_STATE_FULL) {
-          this->in_fifo_state = IN_FIFO_STATE_EMPTY;
+        ++this->busy_cycles;
+        if (!TRANSACTION_LEVEL && this->in_fifo_level > 0u) {
+          ++this->bytes;
+          this->in_fifo_head = (this->in_fifo_head + 1u) % IN_FIFO_DEPTH;
+          --this->in_fifo_level;
           this->ticks_until_done = TICKS_TO_WAIT;
-          p_in__fifo__w__rdy.next = value<1>{1u};
         }
 
-        if (--this->ticks_until_done == 0u) {
+        bool done;
+        if constexpr (EXPLICIT_STOP || TRANSACTION_LEVEL)
+          done = p_stop && this->in_fifo_level == 0u;
+        else
+          done = --this->ticks_until_done == 0u;
+        if (done) {
           p_busy.next = value<1>{0u};
           this->state = STATE_IDLE;
+          if (this->addressed != ADDRESSED_NONE) {
+            this->flush();
+            this->sh1107.finished();
+            this->addressed = ADDRESSED_NONE;
+          }
         }
         break;
       }
       }
 
-      switch (this->in_fifo_state) {
-      case IN_FIFO_STATE_EMPTY: {
-        if (p_in__fifo__w__en) {
-          this->in_fifo_value = p_in__fifo__w__data.get<uint16_t>();
-          this->in_fifo_state = IN_FIFO_STATE_FULL;
-          p_in__fifo__w__rdy.next = value<1>{0u};
-        }
-        break;
+      if (this->in_fifo_level == IN_FIFO_DEPTH)
+        ++this->stalls;
+      p_in__fifo__w__rdy.next =
+          value<1>{this->in_fifo_level < IN_FIFO_DEPTH ? 1u : 0u};
+      this->sh1107.set_bus_idle(this->state == STATE_IDLE);
+    }
+
+    return converged;
+  }
+
+  // Each FIFO write is seen by the SH1107 as it's made; we'd have put it on
+  // the bus in that order anyway.  A START (bit 8) carries the address.
+  void snoop(uint16_t entry) {
+    uint8_t byte = entry & 0xffu;
+
+    if (entry & 0x100u) {
+      if (this->addressed != ADDRESSED_NONE) {
+        this->flush();
+        this->sh1107.finished();
       }
-      case IN_FIFO_STATE_FULL: {
-        if (p_in__fifo__w__en) {
-          std::cerr << "bb_p_i2c_impl: dropping a write: " << std::hex << "0x"
-                    << p_in__fifo__w__data.get<uint16_t>() << std::endl;
-        }
-        break;
+
+      bool read = byte & 1u;
+      if ((byte >> 1) == ADDR) {
+        this->addressed = read ? ADDRESSED_READ : ADDRESSED_WRITE;
+        this->ack = true;
+        this->sh1107.addressed(read);
+      } else {
+        this->addressed = ADDRESSED_NONE;
+        this->ack = false;
       }
+      return;
+    }
+
+    switch (this->addressed) {
+    case ADDRESSED_NONE:
+      break;
+    case ADDRESSED_WRITE:
+      if constexpr (TRANSACTION_LEVEL) {
+        if (this->batch_len == BATCH_BYTES)
+          this->flush();
+        this->batch[this->batch_len++] = byte;
+      } else {
+        this->sh1107.write(byte);
       }
+      break;
+    case ADDRESSED_READ:
+      this->out_fifo_state = OUT_FIFO_STATE_FULL;
+      this->out_fifo_value = this->sh1107.status();
+      p_out__fifo__r__rdy.next = value<1>{1u};
+      p_out__fifo__r__data.next = value<8>{this->out_fifo_value};
+      break;
     }
+  }
 
-    return converged;
+  void flush() {
+    for (size_t i = 0u; i < this->batch_len; ++i)
+      this->sh1107.write(this->batch[i]);
+    this->batch_len = 0u;
   }
 };
 
+// Each value gets its own instantiation, so keep this modest.
+static constexpr uint16_t MAX_TICKS_TO_WAIT = 16u;
+
 std::unique_ptr<bb_p_i2c> bb_p_i2c::create(std::string name,
                                            metadata_map parameters,
                                            metadata_map attributes) {
-  return std::make_unique<bb_p_i2c_impl>();
+  bool explicit_stop =
+      vsh::parameter_uint(name, parameters, "EXPLICIT_STOP", 0u) != 0u;
+  bool transaction_level =
+      vsh::parameter_uint(name, parameters, "TRANSACTION_LEVEL", 0u) != 0u;
+  uint64_t ticks_to_wait =
+      vsh::parameter_uint(name, parameters, "TICKS_TO_WAIT", 7u);
+  if (ticks_to_wait < 1u || ticks_to_wait > MAX_TICKS_TO_WAIT) {
+    std::cerr << "bb_p_i2c_impl: TICKS_TO_WAIT must be in [1, "
+              << MAX_TICKS_TO_WAIT << "], got " << ticks_to_wait
+              << "; using 7" << std::endl;
+    ticks_to_wait = 7u;
+  }
+  uint64_t in_fifo_depth =
+      vsh::parameter_uint(name, parameters, "IN_FIFO_DEPTH", 1u);
+  if (in_fifo_depth < 1u) {
+    std::cerr << "bb_p_i2c_impl: IN_FIFO_DEPTH must be at least 1; using 1"
+              << std::endl;
+    in_fifo_depth = 1u;
+  }
+  uint64_t addr = vsh::parameter_uint(name, parameters, "ADDR", 0x3cu);
+  if (addr > 0x7fu) {
+    std::cerr << "bb_p_i2c_impl: ADDR must be 7 bits, got " << addr
+              << "; using 0x3c" << std::endl;
+    addr = 0x3cu;
+  }
+  // Neither TICKS_TO_WAIT nor EXPLICIT_STOP mean anything at transaction
+  // level, so it only needs the one instantiation.
+  if (transaction_level) {
+    std::cerr << "bb_p_i2c_impl: transaction level; I2C bus timing is not "
+                 "modelled"
+              << std::endl;
+    return std::make_unique<bb_p_i2c_impl<1u, true, true>>(
+        std::move(name), in_fifo_depth, uint8_t(addr));
+  }
+  return vsh::specialise<uint16_t, 1u, MAX_TICKS_TO_WAIT>(
+      static_cast<uint16_t>(ticks_to_wait), [&](auto ticks) {
+        if (explicit_stop)
+          return std::unique_ptr<bb_p_i2c>(
+              std::make_unique<bb_p_i2c_impl<ticks, true, false>>(
+                  std::move(name), in_fifo_depth, uint8_t(addr)));
+        return std::unique_ptr<bb_p_i2c>(
+            std::make_unique<bb_p_i2c_impl<ticks, false, false>>(
+                std::move(name), in_fifo_depth, uint8_t(addr)));
+      });
 }
 
 } // namespace cxxrtl_design
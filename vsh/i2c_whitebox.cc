@@ -0,0 +1,352 @@
+#include "build/sh1107.h"
+#include "vsh/blackbox.h"
+#include "vsh/sh1107_model.h"
+#include <iostream>
+
+/**
+ * The OLED's end of the real I2C bus, decoded here in the design's own eval
+ * rather than edge by edge in vsh's I2CConnector, and fed to our SH1107
+ * model a byte at a time.
+ *
+ * The decoding is I2CConnector's ByteTransmitter, transliterated.
+ */
+
+namespace cxxrtl_design {
+
+struct bb_p_i2c__whitebox_impl : public bb_p_i2c__whitebox,
+                                 public vsh::stateful {
+  const uint8_t ADDR;
+
+  vsh::sh1107 sh1107;
+  vsh::counter bytes, errors;
+  vsh::stats stats;
+
+  bb_p_i2c__whitebox_impl(std::string name, uint8_t addr)
+      : vsh::stateful(name), ADDR(addr), sh1107(name + " sh1107"),
+        stats(std::move(name), {
+                                   {"bytes", &bytes},
+                                   {"errors", &errors},
+                               }) {}
+
+  // As vsh/src/Sample.zig: what a line was on the last posedge and this one.
+  struct sample {
+    bool prev, curr;
+
+    void reset(bool v) { prev = curr = v; }
+    void update(bool v) {
+      prev = curr;
+      curr = v;
+    }
+    bool stable() const { return prev == curr; }
+    bool stable_high() const { return prev && curr; }
+    bool stable_low() const { return !prev && !curr; }
+    bool rising() const { return !prev && curr; }
+    bool falling() const { return prev && !curr; }
+  };
+
+  enum {
+    STATE_IDLE,
+    STATE_START_SDA_LOW,
+    STATE_WAIT_BIT_SCL_RISE,
+    STATE_WAIT_BIT_SCL_FALL,
+    STATE_WAIT_ACK_SCL_RISE,
+    STATE_WAIT_ACK_SCL_FALL,
+  } state;
+
+  sample scl_o, scl_oe, sda_o, sda_oe;
+  enum {
+    RW_W = 0,
+    RW_R = 1,
+  } rw,
+      next_rw;
+  uint8_t bits;
+  uint8_t byte;
+  bool addressed;
+
+  enum result {
+    RESULT_PASS,
+    RESULT_WRITE_ACK,
+    RESULT_READ_ACK,
+    RESULT_SET_SDA_LOW,
+    RESULT_SET_SDA_HIGH,
+    RESULT_ERROR,
+    RESULT_FISH,
+  };
+
+  void reset() override {
+    this->state = STATE_IDLE;
+    this->scl_o.reset(false);
+    this->scl_oe.reset(false);
+    this->sda_o.reset(false);
+    this->sda_oe.reset(false);
+    this->rw = RW_W;
+    this->next_rw = RW_W;
+    this->bits = 0u;
+    this->byte = 0u;
+    this->addressed = false;
+
+    p_sda__i = wire<1>{1u};
+  }
+
+  void save(std::string &out) const override {
+    vsh::put(out, this->state);
+    vsh::put(out, this->scl_o);
+    vsh::put(out, this->scl_oe);
+    vsh::put(out, this->sda_o);
+    vsh::put(out, this->sda_oe);
+    vsh::put(out, this->rw);
+    vsh::put(out, this->next_rw);
+    vsh::put(out, this->bits);
+    vsh::put(out, this->byte);
+    vsh::put(out, this->addressed);
+    vsh::put(out, p_sda__i);
+  }
+
+  bool restore(std::string_view &in) override {
+    return vsh::get(in, this->state) && vsh::get(in, this->scl_o) &&
+           vsh::get(in, this->scl_oe) && vsh::get(in, this->sda_o) &&
+           vsh::get(in, this->sda_oe) && vsh::get(in, this->rw) &&
+           vsh::get(in, this->next_rw) && vsh::get(in, this->bits) &&
+           vsh::get(in, this->byte) && vsh::get(in, this->addressed) &&
+           vsh::get(in, p_sda__i);
+  }
+
+  bool eval(performer *performer) override {
+    bool converged = true;
+    bool posedge_p_clk = this->posedge_p_clk();
+
+    if (posedge_p_clk) {
+      this->scl_o.update(bool(p_scl__o));
+      this->scl_oe.update(bool(p_scl__oe));
+      this->sda_o.update(bool(p_sda__o));
+      this->sda_oe.update(bool(p_sda__oe));
+
+      bool all_stable = this->scl_o.stable() && this->scl_oe.stable() &&
+                        this->sda_o.stable() && this->sda_oe.stable();
+
+      // Nothing happens in IDLE without an edge, and that's where we spend
+      // most of our time.
+      bool idle = this->state == STATE_IDLE && all_stable;
+      this->sh1107.set_bus_idle(idle);
+      if (idle)
+        return converged;
+
+      switch (this->process(all_stable)) {
+      case RESULT_PASS:
+        break;
+      case RESULT_WRITE_ACK: {
+        // XXX(Ch): As I2CConnector: if we get a START for not-us, we pass,
+        // but then imagine the first data byte looks like it addresses us.
+        if (!this->addressed) {
+          uint8_t addr = this->byte >> 1;
+          bool read = (this->byte & 1u) == 1u;
+          if (addr == ADDR) {
+            p_sda__i.next = value<1>{0u};
+            this->addressed = true;
+            this->rw = RW_W;
+            if (read)
+              this->next_rw = RW_R;
+            this->sh1107.addressed(read);
+          }
+        } else {
+          p_sda__i.next = value<1>{0u};
+          ++this->bytes;
+          this->sh1107.write(this->byte);
+        }
+        break;
+      }
+      case RESULT_READ_ACK:
+        break;
+      case RESULT_SET_SDA_LOW:
+        p_sda__i.next = value<1>{0u};
+        break;
+      case RESULT_SET_SDA_HIGH:
+        p_sda__i.next = value<1>{1u};
+        break;
+      case RESULT_ERROR:
+        p_sda__i.next = value<1>{1u};
+        std::cerr << "bb_p_i2c__whitebox_impl: got error, resetting"
+                  << std::endl;
+        ++this->errors;
+        if (this->addressed)
+          this->sh1107.error();
+        this->addressed = false;
+        this->rw = RW_W;
+        break;
+      case RESULT_FISH:
+        p_sda__i.next = value<1>{1u};
+        if (this->addressed)
+          this->sh1107.finished();
+        this->addressed = false;
+        this->rw = RW_W;
+        break;
+      }
+    }
+
+    return converged;
+  }
+
+  result process(bool all_stable) {
+    switch (this->state) {
+    case STATE_IDLE: {
+      if (scl_oe.stable_high() && scl_o.stable_high() &&
+          sda_oe.stable_high() && sda_o.falling()) {
+        this->state = STATE_START_SDA_LOW;
+        this->bits = 0u;
+        this->byte = 0u;
+        return RESULT_SET_SDA_HIGH;
+      }
+      return RESULT_PASS;
+    }
+    case STATE_START_SDA_LOW: {
+      if (scl_oe.stable_high() && scl_o.falling() && sda_oe.stable_high() &&
+          sda_o.stable_low()) {
+        this->state = STATE_WAIT_BIT_SCL_RISE;
+      } else if (!all_stable) {
+        this->state = STATE_IDLE;
+      }
+      return RESULT_PASS;
+    }
+    case STATE_WAIT_BIT_SCL_RISE: {
+      if (this->rw == RW_W) {
+        if (scl_oe.stable_high() && scl_o.rising() && sda_oe.stable_high() &&
+            sda_o.stable()) {
+          this->byte = (this->byte << 1) | (sda_o.curr ? 1u : 0u);
+          this->state = STATE_WAIT_BIT_SCL_FALL;
+        } else if (!scl_oe.stable_high() || !sda_oe.stable_high()) {
+          this->state = STATE_IDLE;
+          return RESULT_ERROR;
+        }
+      } else {
+        if (scl_oe.stable_high() && scl_o.rising() && sda_oe.stable_low()) {
+          this->state = STATE_WAIT_BIT_SCL_FALL;
+        } else if (!scl_oe.stable_high() || !sda_oe.stable_low()) {
+          this->state = STATE_IDLE;
+          return RESULT_ERROR;
+        }
+      }
+      return RESULT_PASS;
+    }
+    case STATE_WAIT_BIT_SCL_FALL: {
+      if (this->rw == RW_W) {
+        if (scl_oe.stable_high() && scl_o.falling() && sda_oe.falling() &&
+            sda_o.stable()) {
+          if (this->bits != 7u) {
+            this->state = STATE_IDLE;
+            return RESULT_ERROR;
+          }
+          this->state = STATE_WAIT_ACK_SCL_RISE;
+          return RESULT_WRITE_ACK;
+        } else if (scl_oe.stable_high() && scl_o.falling() &&
+                   sda_oe.stable_high() && sda_o.stable()) {
+          if (this->bits == 7u) {
+            this->state = STATE_IDLE;
+            return RESULT_ERROR;
+          }
+          ++this->bits;
+          this->state = STATE_WAIT_BIT_SCL_RISE;
+        } else if (scl_oe.stable_high() && scl_o.stable_high() &&
+                   sda_oe.stable_high() && sda_o.rising()) {
+          this->state = STATE_IDLE;
+          if (this->bits == 0u && this->byte == 0u)
+            return RESULT_FISH;
+          return RESULT_ERROR;
+        } else if (scl_oe.stable_high() && scl_o.stable_high() &&
+                   sda_oe.stable_high() && sda_o.falling()) {
+          // repeated start
+          this->state = STATE_START_SDA_LOW;
+          this->rw = RW_W;
+          this->bits = 0u;
+          this->byte = 0u;
+          return RESULT_FISH;
+        } else if (!all_stable) {
+          this->state = STATE_IDLE;
+          return RESULT_ERROR;
+        }
+        return RESULT_PASS;
+      } else {
+        if (scl_oe.stable_high() && scl_o.falling() && sda_oe.stable_low()) {
+          if (this->bits == 7u) {
+            this->state = STATE_WAIT_ACK_SCL_RISE;
+            return RESULT_PASS;
+          }
+          ++this->bits;
+          this->state = STATE_WAIT_BIT_SCL_RISE;
+          return this->prepare_send_bit();
+        } else if (!all_stable) {
+          this->state = STATE_IDLE;
+          return RESULT_ERROR;
+        }
+        return RESULT_PASS;
+      }
+    }
+    case STATE_WAIT_ACK_SCL_RISE: {
+      if (this->rw == RW_W) {
+        if (sda_oe.falling()) {
+          return RESULT_PASS;
+        } else if (scl_oe.stable_high() && scl_o.rising() &&
+                   sda_oe.stable_low()) {
+          this->state = STATE_WAIT_ACK_SCL_FALL;
+        } else if (!all_stable) {
+          this->state = STATE_IDLE;
+          return RESULT_ERROR;
+        }
+        return RESULT_PASS;
+      } else {
+        if (sda_oe.rising()) {
+          return RESULT_PASS;
+        } else if (scl_oe.stable_high() && scl_o.rising() &&
+                   sda_oe.stable_high()) {
+          this->state = STATE_WAIT_ACK_SCL_FALL;
+          if (!sda_o.curr)
+            return RESULT_READ_ACK;
+          this->next_rw = RW_W;
+        } else if (!all_stable) {
+          this->state = STATE_IDLE;
+          return RESULT_ERROR;
+        }
+        return RESULT_PASS;
+      }
+    }
+    case STATE_WAIT_ACK_SCL_FALL: {
+      if (scl_oe.stable_high() && scl_o.falling()) {
+        this->state = STATE_WAIT_BIT_SCL_RISE;
+        this->bits = 0u;
+        this->rw = this->next_rw;
+        if (this->rw == RW_W) {
+          this->byte = 0u;
+          return RESULT_SET_SDA_HIGH;
+        }
+        this->byte = this->sh1107.status();
+        return this->prepare_send_bit();
+      } else if (!(scl_oe.stable() && scl_o.stable())) {
+        this->state = STATE_IDLE;
+        return RESULT_ERROR;
+      }
+      return RESULT_PASS;
+    }
+    }
+
+    return RESULT_PASS;
+  }
+
+  result prepare_send_bit() const {
+    return ((this->byte >> (7u - this->bits)) & 1u) ? RESULT_SET_SDA_HIGH
+                                                     : RESULT_SET_SDA_LOW;
+  }
+};
+
+std::unique_ptr<bb_p_i2c__whitebox>
+bb_p_i2c__whitebox::create(std::string name, metadata_map parameters,
+                           metadata_map attributes) {
+  uint64_t addr = vsh::parameter_uint(name, parameters, "ADDR", 0x3cu);
+  if (addr > 0x7fu) {
+    std::cerr << "bb_p_i2c__whitebox_impl: ADDR must be 7 bits, got " << addr
+              << "; using 0x3c" << std::endl;
+    addr = 0x3cu;
+  }
+  return std::make_unique<bb_p_i2c__whitebox_impl>(std::move(name),
+                                                   static_cast<uint8_t>(addr));
+}
+
+} // namespace cxxrtl_design
@@ -0,0 +1,388 @@
+#include "vsh/sh1107_model.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+namespace vsh {
+
+namespace {
+
+std::mutex models_mutex;
+std::vector<sh1107 *> models;
+
+} // namespace
+
+sh1107::sh1107(std::string name) : stateful(std::move(name)) {
+  this->regs = {};
+  this->regs.dcdc = true;
+  this->regs.dclk_freq = 0b0101u; // 0%
+  this->regs.dclk_ratio = 1u;
+  this->regs.precharge_period = 2u;
+  this->regs.discharge_period = 2u;
+  this->regs.vcom_desel = 0x35u;
+  this->regs.contrast = 0x80u;
+  this->regs.multiplex = 128u;
+
+  std::lock_guard<std::mutex> lock(models_mutex);
+  models.push_back(this);
+}
+
+sh1107::~sh1107() {
+  std::lock_guard<std::mutex> lock(models_mutex);
+  models.erase(std::remove(models.begin(), models.end(), this), models.end());
+}
+
+void sh1107::addressed(bool read) {
+  this->flush();
+  this->mode = read ? MODE_READ : MODE_WRITE;
+  if (!read) {
+    this->parser = PARSER_CONTROL;
+    this->continuation = true;
+    this->valid_finish = false;
+    this->partial_cmd = -1;
+  }
+}
+
+void sh1107::write(uint8_t byte) {
+  if (this->mode != MODE_WRITE) {
+    if (this->mode == MODE_READ)
+      std::cerr << "sh1107: got a byte while addressed for a read"
+                << std::endl;
+    return;
+  }
+
+  this->valid_finish = false;
+
+  switch (this->parser) {
+  case PARSER_CONTROL: {
+    if (byte & 0x3fu)
+      return this->unrecoverable(byte);
+    bool command = !(byte & 0x40u);
+    if (this->partial_cmd >= 0 && !command)
+      return this->unrecoverable(byte);
+
+    this->continuation = byte & 0x80u;
+    this->parser = command ? PARSER_COMMAND : PARSER_DATA;
+    // It's fine to just set the mode, e.g. for reads.
+    this->valid_finish = this->partial_cmd < 0;
+    return;
+  }
+  case PARSER_COMMAND: {
+    decoded d = this->partial_cmd >= 0
+                    ? this->command(uint8_t(this->partial_cmd), byte)
+                    : this->command(byte, -1);
+    if (d == DECODED_BAD ||
+        (d == DECODED_MORE && this->partial_cmd >= 0))
+      return this->unrecoverable(byte);
+
+    if (this->continuation)
+      this->parser = PARSER_CONTROL;
+    else
+      this->valid_finish = true;
+    this->partial_cmd = d == DECODED_MORE ? byte : -1;
+    return;
+  }
+  case PARSER_DATA: {
+    if (this->continuation)
+      this->parser = PARSER_CONTROL;
+    else
+      this->valid_finish = true;
+    this->data(byte);
+    return;
+  }
+  }
+}
+
+void sh1107::unrecoverable(uint8_t byte) {
+  std::cerr << "sh1107: command parser noped out, fed 0x" << std::hex
+            << unsigned(byte) << std::dec << " -- state: " << this->parser
+            << " / continuation: " << this->continuation
+            << " / partial_cmd: " << this->partial_cmd << std::endl;
+  this->mode = MODE_NONE;
+}
+
+uint8_t sh1107::status() const {
+  // not busy, display on/off, ID=7
+  return 0x07u | (this->regs.power ? 0x00u : 0x40u);
+}
+
+void sh1107::finished() {
+  this->flush();
+  if (this->mode == MODE_NONE)
+    std::cerr << "sh1107: i2c fish while unaddressed" << std::endl;
+  else if (this->mode == MODE_WRITE && !this->valid_finish)
+    std::cerr << "sh1107: i2c fish without valid_finish" << std::endl;
+  this->mode = MODE_NONE;
+}
+
+void sh1107::error() {
+  this->flush();
+  std::cerr << "sh1107: i2c error" << std::endl;
+  this->mode = MODE_NONE;
+}
+
+sh1107::decoded sh1107::command(uint8_t byte0, int16_t byte1) {
+  bool one = byte1 < 0;
+  uint8_t arg = uint8_t(byte1);
+
+  // Everything that takes an argument.
+  switch (byte0) {
+  case 0x81u:
+  case 0xa8u:
+  case 0xd3u:
+  case 0xadu:
+  case 0xd5u:
+  case 0xd9u:
+  case 0xdbu:
+  case 0xdcu:
+    if (one)
+      return DECODED_MORE;
+    break;
+  default:
+    if (!one)
+      return DECODED_BAD;
+    break;
+  }
+
+  vsh_sh1107_registers &r = this->regs;
+  this->flush();
+  this->begin_change();
+  decoded result = DECODED_DONE;
+
+  if (byte0 <= 0x0fu) {
+    r.column_address = (r.column_address & 0x70u) | byte0;
+  } else if (byte0 <= 0x17u) {
+    r.column_address = (r.column_address & 0x0fu) | ((byte0 & 0x07u) << 4);
+  } else if (byte0 >= 0xb0u && byte0 <= 0xbfu) {
+    r.page_address = byte0 & 0x0fu;
+  } else if (byte0 >= 0xc0u && byte0 <= 0xcfu) {
+    r.com_scan_dir = (byte0 & 0x08u) ? 1u : 0u;
+  } else {
+    switch (byte0) {
+    case 0x20u:
+    case 0x21u:
+      r.addressing_mode = byte0 & 1u;
+      break;
+    case 0x81u:
+      r.contrast = arg;
+      break;
+    case 0xa0u:
+    case 0xa1u:
+      r.segment_remap = byte0 & 1u;
+      break;
+    case 0xa8u:
+      r.multiplex = (arg & 0x7fu) + 1u;
+      break;
+    case 0xa4u:
+    case 0xa5u:
+      r.all_on = byte0 & 1u;
+      break;
+    case 0xa6u:
+    case 0xa7u:
+      r.reversed = byte0 & 1u;
+      break;
+    case 0xd3u:
+      r.start_offset = arg & 0x7fu;
+      break;
+    case 0xadu:
+      r.dcdc = arg == 0x8bu;
+      break;
+    case 0xaeu:
+    case 0xafu:
+      r.power = byte0 & 1u;
+      break;
+    case 0xd5u:
+      r.dclk_ratio = (arg & 0x0fu) + 1u;
+      r.dclk_freq = arg >> 4;
+      break;
+    case 0xd9u:
+      r.precharge_period = arg & 0x0fu;
+      r.discharge_period = arg >> 4;
+      break;
+    case 0xdbu:
+      r.vcom_desel = arg;
+      break;
+    case 0xdcu:
+      r.start_line = arg & 0x7fu;
+      break;
+    case 0xe0u:
+    case 0xeeu:
+      std::cerr << "sh1107: read-modify-write not implemented" << std::endl;
+      break;
+    case 0xe3u:
+      break;
+    default:
+      result = DECODED_BAD;
+      break;
+    }
+  }
+
+  this->end_change();
+  if (result == DECODED_DONE)
+    ++this->commands;
+  return result;
+}
+
+void sh1107::data(uint8_t b) {
+  vsh_sh1107_registers &r = this->regs;
+  // With a run pending, column_address hasn't been moved past it yet.
+  uint8_t column = (r.column_address + this->run.length) & 0x7fu;
+  uint8_t page = r.page_address & 0x0fu;
+
+  // Flipped segments come out upside down, bits and pages both.
+  uint8_t row_page, value;
+  if (r.segment_remap == 0u) {
+    row_page = page;
+    value = b;
+  } else {
+    row_page = PAGES - 1u - page;
+    value = 0u;
+    for (unsigned i = 0u; i < 8u; ++i)
+      value |= ((b >> i) & 1u) << (7u - i);
+  }
+
+  size_t byte = size_t(row_page) * WIDTH + column;
+  uint8_t bit = uint8_t(1u << (byte % 8u));
+
+  if (r.addressing_mode == 0u) {
+    // A run ends at a different byte, or when the column wraps.
+    if (this->run.length > 0u && (value != this->run.value || column == 0u))
+      this->flush();
+    if (this->run.length == 0u) {
+      this->run.start = uint16_t(byte);
+      this->run.value = value;
+    }
+    ++this->run.length;
+    if (!(this->gddram_written[byte / 8u] & bit))
+      ++this->run.fresh;
+    if (this->gddram[byte] != value)
+      ++this->run.changes;
+    return;
+  }
+
+  this->begin_change();
+  if (this->gddram[byte] != value)
+    ++this->changed;
+  this->gddram[byte] = value;
+  ++this->gddram_gen;
+  if (!(this->gddram_written[byte / 8u] & bit)) {
+    this->gddram_written[byte / 8u] |= bit;
+    ++this->written;
+  }
+  r.page_address = (page + 1u) & 0x0fu;
+  this->end_change();
+}
+
+void sh1107::flush() {
+  if (this->run.length == 0u)
+    return;
+
+  this->begin_change();
+  std::memset(this->gddram + this->run.start, this->run.value,
+              this->run.length);
+  ++this->gddram_gen;
+  for (size_t byte = this->run.start;
+       byte < size_t(this->run.start) + this->run.length; ++byte)
+    this->gddram_written[byte / 8u] |= uint8_t(1u << (byte % 8u));
+  this->written += this->run.fresh;
+  this->changed += this->run.changes;
+  this->regs.column_address =
+      (this->regs.column_address + this->run.length) & 0x7fu;
+  this->end_change();
+  this->run = {};
+}
+
+// The usual seqlock: if seq moved (or was odd) while we copied, we raced the
+// writer and go again.
+bool sh1107::snapshot(uint64_t &seen, uint64_t &gddram_seen,
+                      vsh_sh1107_registers &regs, uint8_t *out) const {
+  for (;;) {
+    uint64_t before = this->seq.load(std::memory_order_acquire);
+    if (before == seen)
+      return false;
+    if (before & 1u)
+      continue;
+
+    std::memcpy(&regs, &this->regs, sizeof(regs));
+    uint64_t gen = this->gddram_gen;
+    if (gen != gddram_seen)
+      std::memcpy(out, this->gddram, GDDRAM_BYTES);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (this->seq.load(std::memory_order_relaxed) == before) {
+      seen = before;
+      gddram_seen = gen;
+      return true;
+    }
+  }
+}
+
+void sh1107::save(std::string &out) const {
+  put(out, this->mode);
+  put(out, this->parser);
+  put(out, this->continuation);
+  put(out, this->valid_finish);
+  put(out, this->partial_cmd);
+  put(out, this->bus_idle);
+  put(out, this->regs);
+  put(out, this->gddram);
+  put(out, this->gddram_written);
+  put(out, this->written);
+  put(out, this->changed);
+  put(out, this->run);
+}
+
+bool sh1107::restore(std::string_view &in) {
+  this->begin_change();
+  bool ok = get(in, this->mode) && get(in, this->parser) &&
+            get(in, this->continuation) && get(in, this->valid_finish) &&
+            get(in, this->partial_cmd) && get(in, this->bus_idle) &&
+            get(in, this->regs) && get(in, this->gddram) &&
+            get(in, this->gddram_written) && get(in, this->written) &&
+            get(in, this->changed) && get(in, this->run) &&
+            this->mode <= MODE_READ && this->parser <= PARSER_DATA &&
+            this->written <= GDDRAM_BYTES &&
+            size_t(this->run.start) + this->run.length <= GDDRAM_BYTES;
+  ++this->gddram_gen;
+  this->end_change();
+  return ok;
+}
+
+} // namespace vsh
+
+extern "C" vsh::sh1107 *vsh_sh1107_find(uint64_t design) {
+  std::lock_guard<std::mutex> lock(vsh::models_mutex);
+  for (auto *model : vsh::models)
+    if (model->design == design)
+      return model;
+  return nullptr;
+}
+
+extern "C" const uint8_t *vsh_sh1107_framebuffer(vsh::sh1107 *model) {
+  return model->framebuffer();
+}
+
+extern "C" size_t vsh_sh1107_written_count(const vsh::sh1107 *model) {
+  return model->written_count();
+}
+
+extern "C" uint64_t vsh_sh1107_changed_count(const vsh::sh1107 *model) {
+  return model->changed_count();
+}
+
+extern "C" uint64_t vsh_sh1107_command_count(const vsh::sh1107 *model) {
+  return model->command_count();
+}
+
+extern "C" bool vsh_sh1107_quiet(const vsh::sh1107 *model) {
+  return model->quiet();
+}
+
+extern "C" bool vsh_sh1107_snapshot(const vsh::sh1107 *model, uint64_t *seen,
+                                    uint64_t *gddram_seen,
+                                    vsh_sh1107_registers *regs,
+                                    uint8_t *gddram) {
+  return model->snapshot(*seen, *gddram_seen, *regs, gddram);
+}
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "vsh/blackbox.h"
+
+/**
+ * The SH1107 itself, for the I2C blackbox and whitebox to feed the bytes
+ * addressed to it as they go by, so vsh doesn't have to watch the bus.  This
+ * is vsh/src/Cmd.zig's Parser and vsh/src/SH1107.zig, transliterated; keep
+ * them in step.
+ */
+
+// The registers vsh shows, laid out for vsh/src/Cxxrtl.zig's SH1107Registers.
+struct vsh_sh1107_registers {
+  bool power;
+  bool dcdc;
+  uint8_t dclk_freq;
+  uint8_t dclk_ratio;
+  uint8_t precharge_period;
+  uint8_t discharge_period;
+  uint8_t vcom_desel;
+  bool all_on;
+  bool reversed;
+  uint8_t contrast;
+  uint8_t start_line;
+  uint8_t start_offset;
+  uint8_t page_address;
+  uint8_t column_address;
+  uint8_t addressing_mode;
+  uint8_t multiplex;
+  uint8_t segment_remap;
+  uint8_t com_scan_dir;
+};
+
+namespace vsh {
+
+class sh1107 : public stateful {
+public:
+  static constexpr size_t WIDTH = 128u;
+  static constexpr size_t PAGES = 16u;
+  // A byte per column per page, LSB at the top, as FPGAThread.framebuffer.
+  static constexpr size_t GDDRAM_BYTES = WIDTH * PAGES;
+
+  explicit sh1107(std::string name);
+  ~sh1107() override;
+
+  // The bus has addressed us for a write or a read.
+  void addressed(bool read);
+  // A byte written to us while addressed for a write.
+  void write(uint8_t byte);
+  // What we answer a read with.
+  uint8_t status() const;
+  // The transaction's over (a stop or repeated start), or went bad.
+  void finished();
+  void error();
+
+  // The host's told us whether the bus is doing anything at all.
+  void set_bus_idle(bool idle) { this->bus_idle = idle; }
+  bool quiet() const { return this->bus_idle && this->mode == MODE_NONE; }
+
+  // Only for the thread feeding us.
+  const uint8_t *framebuffer() {
+    this->flush();
+    return this->gddram;
+  }
+  size_t written_count() const { return this->written + this->run.fresh; }
+  // How many data writes have changed a GDDRAM byte.
+  uint64_t changed_count() const {
+    return this->changed + this->run.changes;
+  }
+  // How many commands we've carried out, for the --report.  Not saved.
+  uint64_t command_count() const { return this->commands; }
+
+  // For any thread: copies the registers out if anything's changed since
+  // seen, and GDDRAM too if it's changed since gddram_seen, and updates them.
+  // Returns whether anything had.  Scrolling and the like only touch the
+  // registers, so they don't cost a GDDRAM copy.  A pending run
+  // isn't in GDDRAM yet; it shows up once flushed, at the latest when the
+  // transaction ends.
+  bool snapshot(uint64_t &seen, uint64_t &gddram_seen,
+                vsh_sh1107_registers &regs, uint8_t *out) const;
+
+  void save(std::string &out) const override;
+  bool restore(std::string_view &in) override;
+
+private:
+  enum {
+    MODE_NONE,
+    MODE_WRITE,
+    MODE_READ,
+  } mode = MODE_NONE;
+
+  // Cmd.Parser.
+  enum {
+    PARSER_CONTROL,
+    PARSER_COMMAND,
+    PARSER_DATA,
+  } parser = PARSER_CONTROL;
+  bool continuation = true;
+  bool valid_finish = false;
+  int16_t partial_cmd = -1;
+
+  bool bus_idle = true;
+
+  vsh_sh1107_registers regs;
+  uint8_t gddram[GDDRAM_BYTES] = {};
+  uint8_t gddram_written[GDDRAM_BYTES / 8] = {};
+  size_t written = 0u;
+  uint64_t changed = 0u;
+  uint64_t commands = 0u;
+
+  // Identical data bytes written in a row in page addressing mode (a clear or
+  // a fill, most often) aren't stored one by one; we note the run and write
+  // it out with one memset in flush().  Until then, column_address stays
+  // where the run started, and snapshot doesn't see it.  fresh and changes
+  // are the run's contributions to written and changed.
+  struct {
+    uint16_t start;
+    uint8_t value;
+    uint8_t length;
+    uint16_t fresh;
+    uint16_t changes;
+  } run = {};
+
+  // Odd while we're changing regs or gddram, so snapshot can tell it raced.
+  std::atomic<uint64_t> seq{0u};
+  // Bumped (inside a change) whenever gddram is.  Starts ahead of any
+  // snapshot's gddram_seen, so the first copies it.
+  uint64_t gddram_gen = 1u;
+
+  void begin_change() {
+    this->seq.store(this->seq.load(std::memory_order_relaxed) + 1u,
+                    std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+  }
+  void end_change() {
+    this->seq.store(this->seq.load(std::memory_order_relaxed) + 1u,
+                    std::memory_order_release);
+  }
+
+  // Decodes and carries out the command in byte0 (and byte1, if it's not
+  // -1), as Cmd.Command.from.
+  enum decoded {
+    DECODED_DONE,
+    DECODED_MORE,
+    DECODED_BAD,
+  };
+  decoded command(uint8_t byte0, int16_t byte1);
+  void data(uint8_t byte);
+  void flush();
+  void unrecoverable(uint8_t byte);
+};
+
+} // namespace vsh
+
+// Finds the first SH1107 model belonging to the design (see
+// vsh_design_begin), or returns null if it has none.
+extern "C" vsh::sh1107 *vsh_sh1107_find(uint64_t design);
+extern "C" const uint8_t *vsh_sh1107_framebuffer(vsh::sh1107 *model);
+extern "C" size_t vsh_sh1107_written_count(const vsh::sh1107 *model);
+extern "C" uint64_t vsh_sh1107_changed_count(const vsh::sh1107 *model);
+extern "C" uint64_t vsh_sh1107_command_count(const vsh::sh1107 *model);
+extern "C" bool vsh_sh1107_quiet(const vsh::sh1107 *model);
+extern "C" bool vsh_sh1107_snapshot(const vsh::sh1107 *model, uint64_t *seen,
+                                    uint64_t *gddram_seen,
+                                    vsh_sh1107_registers *regs,
+                                    uint8_t *gddram);
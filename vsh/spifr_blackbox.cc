@@ -1,20 +1,44 @@
 #include "build/sh1107.h"
+#include "vsh/blackbox.h"
 #include <iostream>
 
 /**
  * Yawonk.
  */
 
-extern "C" const uint8_t *spi_flash_content;
-extern "C" uint32_t spi_flash_base;
-extern "C" uint32_t spi_flash_length;
-
 namespace cxxrtl_design {
 
-struct bb_p_spifr_impl : public bb_p_spifr {
-  // Similar to bb_p_i2c_impl::TICKS_TO_WAIT, but between each cycle with valid
-  // data.
-  const uint8_t COUNTDOWN_BETWEEN_BYTES = 2u;
+// COUNTDOWN_BETWEEN_BYTES is similar to bb_p_i2c_impl's TICKS_TO_WAIT, but
+// between each cycle with valid data.  Set from the BYTE_PERIOD parameter; 1 is
+// "burst" mode, presenting a byte every cycle.  The real SPIFlashReader takes at
+// least 8 cycles a byte, so anything goes as long as the design can drink from
+// the firehose.
+//
+// A real part also takes a while to get going: the command and address have
+// to be shifted in before the first byte comes out.  FIRST_BYTE_LATENCY is
+// the cycles from stb to the first byte, and defaults to BYTE_PERIOD, which
+// is to say none to speak of.  With CONTINUOUS_READ, a read that starts where
+// the last one left off carries on streaming without being addressed again,
+// as a part in continuous read mode would, and pays only BYTE_PERIOD.
+template <uint8_t COUNTDOWN_BETWEEN_BYTES>
+struct bb_p_spifr_impl : public bb_p_spifr, public vsh::stateful {
+  const vsh::flash FLASH;
+  const uint16_t FIRST_BYTE_LATENCY;
+  const bool CONTINUOUS_READ;
+
+  bb_p_spifr_impl(std::string name, vsh::flash flash,
+                  uint16_t first_byte_latency, bool continuous_read)
+      : vsh::stateful(name), FLASH(std::move(flash)),
+        FIRST_BYTE_LATENCY(first_byte_latency),
+        CONTINUOUS_READ(continuous_read),
+        stats(std::move(name), {
+                                   {"transactions", &transactions},
+                                   {"continued", &continued},
+                                   {"bytes", &bytes},
+                                   {"busy", &busy_cycles},
+                                   {"waiting", &waiting_cycles},
+                                   {"idle", &idle_cycles},
+                               }) {}
 
   enum {
     STATE_IDLE,
@@ -23,19 +47,51 @@ struct bb_p_spifr_impl : public bb_p_spifr {
 
   uint32_t address;
   uint16_t remaining;
-  uint8_t countdown;
+  uint16_t countdown;
+  // Whether we're yet to present the transaction's first byte.
+  bool first;
+  // Whether there's a stream under way to carry on from, at address.
+  bool streaming;
+
+  // Kept across resets.  A transaction continued is one that didn't need
+  // addressing; a cycle waiting is one spent busy before its first byte.
+  vsh::counter transactions, continued, bytes, busy_cycles, waiting_cycles,
+      idle_cycles;
+  vsh::stats stats;
 
   void reset() override {
     this->state = STATE_IDLE;
     this->address = 0u;
     this->remaining = 0u;
     this->countdown = 0u;
+    this->first = false;
+    this->streaming = false;
 
     p_busy = wire<1>{0u};
     p_data = wire<8>{0u};
     p_valid = wire<1>{0u};
   }
 
+  void save(std::string &out) const override {
+    vsh::put(out, this->state);
+    vsh::put(out, this->address);
+    vsh::put(out, this->remaining);
+    vsh::put(out, this->countdown);
+    vsh::put(out, this->first);
+    vsh::put(out, this->streaming);
+    vsh::put(out, p_busy);
+    vsh::put(out, p_data);
+    vsh::put(out, p_valid);
+  }
+
+  bool restore(std::string_view &in) override {
+    return vsh::get(in, this->state) && vsh::get(in, this->address) &&
+           vsh::get(in, this->remaining) && vsh::get(in, this->countdown) &&
+           vsh::get(in, this->first) && vsh::get(in, this->streaming) &&
+           vsh::get(in, p_busy) && vsh::get(in, p_data) &&
+           vsh::get(in, p_valid);
+  }
+
   bool eval(performer *performer) override {
     bool converged = true;
     bool posedge_p_clk = this->posedge_p_clk();
@@ -45,32 +101,40 @@ struct bb_p_spifr_impl : public bb_p_spifr {
 
       switch (this->state) {
       case STATE_IDLE: {
+        ++this->idle_cycles;
         if (p_stb) {
-          this->address = p_addr.get<uint32_t>();
+          uint32_t address = p_addr.get<uint32_t>();
+          bool carry_on = CONTINUOUS_READ && this->streaming &&
+                          address == this->address;
+          this->address = address;
           this->remaining = p_len.get<uint16_t>();
 
-          if (this->address >= spi_flash_base &&
-              this->address < spi_flash_base + spi_flash_length) {
-            p_busy.next = value<1>{1u};
-            this->state = STATE_READ;
-            this->countdown = COUNTDOWN_BETWEEN_BYTES;
-          }
+          p_busy.next = value<1>{1u};
+          this->state = STATE_READ;
+          this->countdown =
+              carry_on ? COUNTDOWN_BETWEEN_BYTES : FIRST_BYTE_LATENCY;
+          this->first = true;
+          this->streaming = true;
+          ++this->transactions;
+          if (carry_on)
+            ++this->continued;
         }
         break;
       }
       case STATE_READ: {
+        ++this->busy_cycles;
+        if (this->first)
+          ++this->waiting_cycles;
         if (--this->countdown == 0u) {
+          this->first = false;
           if (this->remaining == 0u) {
             p_busy.next = value<1>{0u};
             this->state = STATE_IDLE;
           } else {
             this->countdown = COUNTDOWN_BETWEEN_BYTES;
-            if (this->address - spi_flash_base < spi_flash_length)
-              p_data.next =
-                  value<8>{spi_flash_content[this->address - spi_flash_base]};
-            else
-              p_data.next = value<8>{0xffu};
+            p_data.next = value<8>{FLASH.read(this->address)};
             p_valid.next = value<1>{1u};
+            ++this->bytes;
 
             ++this->address;
             --this->remaining;
@@ -85,10 +149,40 @@ struct bb_p_spifr_impl : public bb_p_spifr {
   }
 };
 
+// Each value gets its own instantiation; 16 is twice what the real thing
+// manages.
+static constexpr uint8_t MAX_BYTE_PERIOD = 16u;
+
 std::unique_ptr<bb_p_spifr> bb_p_spifr::create(std::string name,
                                                metadata_map parameters,
                                                metadata_map attributes) {
-  return std::make_unique<bb_p_spifr_impl>();
+  uint64_t byte_period =
+      vsh::parameter_uint(name, parameters, "BYTE_PERIOD", 2u);
+  if (byte_period < 1u || byte_period > MAX_BYTE_PERIOD) {
+    std::cerr << "bb_p_spifr_impl: BYTE_PERIOD must be in [1, "
+              << unsigned(MAX_BYTE_PERIOD) << "], got " << byte_period
+              << "; using 2" << std::endl;
+    byte_period = 2u;
+  }
+  uint64_t first_byte_latency =
+      vsh::parameter_uint(name, parameters, "FIRST_BYTE_LATENCY", 0u);
+  if (first_byte_latency == 0u) {
+    first_byte_latency = byte_period;
+  } else if (first_byte_latency > UINT16_MAX) {
+    std::cerr << "bb_p_spifr_impl: FIRST_BYTE_LATENCY must be at most "
+              << UINT16_MAX << ", got " << first_byte_latency << "; using "
+              << byte_period << std::endl;
+    first_byte_latency = byte_period;
+  }
+  bool continuous_read =
+      vsh::parameter_uint(name, parameters, "CONTINUOUS_READ", 0u) != 0u;
+  return vsh::specialise<uint8_t, 1u, MAX_BYTE_PERIOD>(
+      static_cast<uint8_t>(byte_period), [&](auto period) {
+        return std::unique_ptr<bb_p_spifr>(
+            std::make_unique<bb_p_spifr_impl<period>>(
+                std::move(name), vsh::flash::current(),
+                static_cast<uint16_t>(first_byte_latency), continuous_read));
+      });
 }
 
 } // namespace cxxrtl_design
@@ -1,17 +1,26 @@
 #include "build/sh1107.h"
+#include "vsh/blackbox.h"
 #include <iostream>
 
 /**
  * Yawonk.
  */
 
-extern "C" const uint8_t *spi_flash_content;
-extern "C" uint32_t spi_flash_base;
-extern "C" uint32_t spi_flash_length;
-
 namespace cxxrtl_design {
 
-struct bb_p_spifr__whitebox_impl : public bb_p_spifr__whitebox {
+struct bb_p_spifr__whitebox_impl : public bb_p_spifr__whitebox,
+                                   public vsh::stateful {
+  const vsh::flash FLASH;
+
+  bb_p_spifr__whitebox_impl(std::string name, vsh::flash flash)
+      : vsh::stateful(name), FLASH(std::move(flash)),
+        stats(std::move(name), {
+                                   {"reads", &reads},
+                                   {"bytes", &bytes},
+                                   {"busy", &busy_cycles},
+                                   {"idle", &idle_cycles},
+                               }) {}
+
   enum {
     STATE_IDLE,
     STATE_SELECTED_POWER_DOWN,
@@ -23,19 +32,46 @@ struct bb_p_spifr__whitebox_impl : public bb_p_spifr__whitebox {
 
   uint32_t sr;
   uint8_t edges;
-  uint32_t addr;
   uint8_t bit;
 
+  // Once a READ's address is in, we shift a byte at a time out of a latch,
+  // reloading it from address (which wraps around the flash) as it empties.
+  uint32_t address;
+  uint8_t shift;
+
+  // Kept across resets.  Busy is any cycle with cs asserted; bytes only
+  // counts those actually shifted out of the flash.
+  vsh::counter reads, bytes, busy_cycles, idle_cycles;
+  vsh::stats stats;
+
   void reset() override {
     this->state = STATE_IDLE;
     this->sr = 0u;
     this->edges = 0u;
-    this->addr = 0u;
     this->bit = 0u;
+    this->address = 0u;
+    this->shift = 0u;
 
     p_cipo = wire<1>{0u};
   }
 
+  void save(std::string &out) const override {
+    vsh::put(out, this->state);
+    vsh::put(out, this->sr);
+    vsh::put(out, this->edges);
+    vsh::put(out, this->bit);
+    vsh::put(out, this->address);
+    vsh::put(out, this->shift);
+    vsh::put(out, p_cipo);
+  }
+
+  bool restore(std::string_view &in) override {
+    return vsh::get(in, this->state) && vsh::get(in, this->sr) &&
+           vsh::get(in, this->edges) && vsh::get(in, this->bit) &&
+           vsh::get(in, this->address) && vsh::get(in, this->shift) &&
+           vsh::get(in, p_cipo);
+  }
+
   bool eval(performer *performer) override {
     bool converged = true;
     bool posedge_p_clk = this->posedge_p_clk();
@@ -73,24 +109,23 @@ struct bb_p_spifr__whitebox_impl : public bb_p_spifr__whitebox {
       }
       case STATE_SELECTED_POWERED_UP: {
         if (this->edges == 31u && (srnext >> 24) == 0x03u) {
-          this->addr = srnext & 0x00ffffffu;
+          this->address = srnext & 0x00ffffffu;
+          this->shift =
+              static_cast<uint8_t>(FLASH.read(this->address++) << this->bit);
           this->state = STATE_READING;
+          ++this->reads;
           // fallthrough
         } else {
           break;
         }
       }
       case STATE_READING: {
-        if (this->addr >= spi_flash_base &&
-            this->addr < spi_flash_base + spi_flash_length) {
-          uint8_t bit = (spi_flash_content[this->addr - spi_flash_base] >>
-                         (7 - this->bit)) &
-                        0x1;
-          if (++this->bit == 8) {
-            this->bit = 0;
-            ++this->addr;
-          }
-          p_cipo.next = value<1>{bit};
+        p_cipo.next = value<1>{static_cast<uint32_t>(this->shift >> 7)};
+        this->shift <<= 1;
+        if (++this->bit == 8) {
+          this->bit = 0;
+          ++this->bytes;
+          this->shift = FLASH.read(this->address++);
         }
         if (!p_cs) {
           this->state = STATE_IDLE;
@@ -102,8 +137,10 @@ struct bb_p_spifr__whitebox_impl : public bb_p_spifr__whitebox {
       if (p_cs) {
         this->sr = srnext;
         ++this->edges;
+        ++this->busy_cycles;
       } else {
         this->edges = 0;
+        ++this->idle_cycles;
       }
     }
 
@@ -114,7 +151,8 @@ struct bb_p_spifr__whitebox_impl : public bb_p_spifr__whitebox {
 std::unique_ptr<bb_p_spifr__whitebox>
 bb_p_spifr__whitebox::create(std::string name, metadata_map parameters,
                              metadata_map attributes) {
-  return std::make_unique<bb_p_spifr__whitebox_impl>();
+  return std::make_unique<bb_p_spifr__whitebox_impl>(std::move(name),
+                                                     vsh::flash::current());
 }
 
 } // namespace cxxrtl_design
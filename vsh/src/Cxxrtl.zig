@@ -6,14 +6,30 @@ const c = @cImport({
 });
 
 extern "c" fn cxxrtl_design_create() c.cxxrtl_toplevel;
+extern "c" fn vsh_stats_format(buf: [*]u8, size: usize) usize;
+extern "c" fn vsh_stats_format_json(buf: [*]u8, size: usize) usize;
+extern "c" fn vsh_design_begin() u64;
+extern "c" fn vsh_blackbox_save(design: u64, buf: [*]u8, size: usize) usize;
+extern "c" fn vsh_blackbox_restore(design: u64, buf: [*]const u8, size: usize) bool;
+extern "c" fn vsh_sh1107_find(design: u64) ?*anyopaque;
+extern "c" fn vsh_sh1107_framebuffer(model: *anyopaque) [*]const u8;
+extern "c" fn vsh_sh1107_written_count(model: *const anyopaque) usize;
+extern "c" fn vsh_sh1107_changed_count(model: *const anyopaque) u64;
+extern "c" fn vsh_sh1107_command_count(model: *const anyopaque) u64;
+extern "c" fn vsh_sh1107_quiet(model: *const anyopaque) bool;
+extern "c" fn vsh_sh1107_snapshot(model: *const anyopaque, seen: *u64, gddram_seen: *u64, regs: *SH1107Registers, gddram: [*]u8) bool;
 
 const Cxxrtl = @This();
 
 handle: c.cxxrtl_handle,
+// Which blackboxes are ours, for saveBlackboxes/loadBlackboxes.
+design: u64,
 
 pub fn init() Cxxrtl {
+    const design = vsh_design_begin();
     return .{
         .handle = c.cxxrtl_create(cxxrtl_design_create()),
+        .design = design,
     };
 }
 
@@ -29,14 +45,204 @@ pub fn find(self: Cxxrtl, comptime T: type, name: [:0]const u8) ?Object(T) {
     }
 }
 
-pub fn step(self: Cxxrtl) void {
-    _ = c.cxxrtl_step(self.handle);
+// Returns the number of delta cycles it took to settle.
+pub fn step(self: Cxxrtl) usize {
+    return c.cxxrtl_step(self.handle);
 }
 
 pub fn deinit(self: Cxxrtl) void {
     c.cxxrtl_destroy(self.handle);
 }
 
+// Appends the curr of every wire and memory in the design to out, for
+// loadValues to put back.  Values are left out; the next step recomputes them.
+//
+// Each part of each object is a record: its name's length and name, the part
+// index, then its chunk count and chunks.
+pub fn saveValues(self: Cxxrtl, out: *std.ArrayList(u8)) !void {
+    var ctx = SaveContext{ .out = out };
+    c.cxxrtl_enum(self.handle, &ctx, SaveContext.callback);
+    return ctx.err orelse {};
+}
+
+const SaveContext = struct {
+    out: *std.ArrayList(u8),
+    err: ?anyerror = null,
+
+    fn callback(data: ?*anyopaque, name: [*c]const u8, object: [*c]c.cxxrtl_object, parts: usize) callconv(.C) void {
+        const self: *SaveContext = @ptrCast(@alignCast(data.?));
+        if (self.err != null) {
+            return;
+        }
+        self.add(std.mem.span(name), object[0..parts]) catch |err| {
+            self.err = err;
+        };
+    }
+
+    fn add(self: *SaveContext, name: []const u8, objects: []const c.cxxrtl_object) !void {
+        const writer = self.out.writer();
+        for (objects, 0..) |object, part| {
+            const chunks = stateChunks(object) orelse continue;
+            try writer.writeIntNative(u32, @as(u32, @intCast(name.len)));
+            try writer.writeAll(name);
+            try writer.writeIntNative(u32, @as(u32, @intCast(part)));
+            try writer.writeIntNative(u32, @as(u32, @intCast(chunks)));
+            try writer.writeAll(std.mem.sliceAsBytes(object.curr[0..chunks]));
+        }
+    }
+};
+
+// How many chunks of state object holds, if it holds any.
+fn stateChunks(object: c.cxxrtl_object) ?usize {
+    const per_element = (object.width + 31) / 32;
+    return switch (object.type) {
+        c.CXXRTL_WIRE => per_element,
+        c.CXXRTL_MEMORY => per_element * object.depth,
+        else => null,
+    };
+}
+
+// Restores what saveValues wrote into a design built from the same source.
+pub fn loadValues(self: Cxxrtl, allocator: std.mem.Allocator, in: []const u8) !void {
+    var stream = std.io.fixedBufferStream(in);
+    const reader = stream.reader();
+
+    while (stream.pos < in.len) {
+        const name_len = try reader.readIntNative(u32);
+        const name = try allocator.allocSentinel(u8, name_len, 0);
+        defer allocator.free(name);
+        try reader.readNoEof(name);
+        const part = try reader.readIntNative(u32);
+        const chunks = try reader.readIntNative(u32);
+
+        var parts: usize = 0;
+        const objects = c.cxxrtl_get_parts(self.handle, name.ptr, &parts) orelse return error.StateMismatch;
+        if (part >= parts) {
+            return error.StateMismatch;
+        }
+        const object = objects[part];
+        if (stateChunks(object) != chunks) {
+            return error.StateMismatch;
+        }
+
+        try reader.readNoEof(std.mem.sliceAsBytes(object.curr[0..chunks]));
+        if (object.next != null) {
+            @memcpy(object.next[0..chunks], object.curr[0..chunks]);
+        }
+    }
+}
+
+// Appends the state of our blackboxes to out.
+pub fn saveBlackboxes(self: Cxxrtl, out: *std.ArrayList(u8)) !void {
+    const start = out.items.len;
+    const len = vsh_blackbox_save(self.design, out.items.ptr + start, 0);
+    try out.resize(start + len);
+    _ = vsh_blackbox_save(self.design, out.items.ptr + start, len);
+}
+
+pub fn loadBlackboxes(self: Cxxrtl, in: []const u8) !void {
+    if (!vsh_blackbox_restore(self.design, in.ptr, in.len)) {
+        return error.StateMismatch;
+    }
+}
+
+// The SH1107 model inside the design's I2C blackbox or whitebox, if it has
+// one; see vsh/sh1107_model.h.
+pub fn sh1107Model(self: Cxxrtl) ?SH1107Model {
+    if (vsh_sh1107_find(self.design)) |ptr| {
+        return .{ .ptr = ptr };
+    }
+    return null;
+}
+
+// Keep in step with vsh_sh1107_registers.
+pub const SH1107Registers = extern struct {
+    power: bool,
+    dcdc: bool,
+    dclk_freq: u8,
+    dclk_ratio: u8,
+    precharge_period: u8,
+    discharge_period: u8,
+    vcom_desel: u8,
+    all_on: bool,
+    reversed: bool,
+    contrast: u8,
+    start_line: u8,
+    start_offset: u8,
+    page_address: u8,
+    column_address: u8,
+    addressing_mode: u8,
+    multiplex: u8,
+    segment_remap: u8,
+    com_scan_dir: u8,
+};
+
+pub const SH1107Model = struct {
+    ptr: *anyopaque,
+
+    pub const gddram_bytes = 128 * 16;
+
+    // Only from the simulation thread.
+    pub fn framebuffer(self: SH1107Model) *const [gddram_bytes]u8 {
+        return vsh_sh1107_framebuffer(self.ptr)[0..gddram_bytes];
+    }
+
+    pub fn writtenCount(self: SH1107Model) usize {
+        return vsh_sh1107_written_count(self.ptr);
+    }
+
+    pub fn changedCount(self: SH1107Model) u64 {
+        return vsh_sh1107_changed_count(self.ptr);
+    }
+
+    pub fn commandCount(self: SH1107Model) u64 {
+        return vsh_sh1107_command_count(self.ptr);
+    }
+
+    pub fn quiet(self: SH1107Model) bool {
+        return vsh_sh1107_quiet(self.ptr);
+    }
+
+    // From any thread: copies out the registers if anything's changed since
+    // seen, and GDDRAM if it's changed since gddram_seen, and returns whether
+    // anything had.
+    pub fn snapshot(self: SH1107Model, seen: *u64, gddram_seen: *u64, regs: *SH1107Registers, gddram: *[gddram_bytes]u8) bool {
+        return vsh_sh1107_snapshot(self.ptr, seen, gddram_seen, regs, gddram);
+    }
+};
+
+// Formats the counters of every live blackbox into buf, a line each, and
+// returns as much as fit.
+pub fn blackboxStats(buf: []u8) []const u8 {
+    const len = vsh_stats_format(buf.ptr, buf.len);
+    return buf[0..@min(len, buf.len -| 1)];
+}
+
+// The counters of every live blackbox as a JSON array, an object with its
+// name and counters each.  Owned by the caller.
+pub fn blackboxStatsJson(allocator: std.mem.Allocator) ![]u8 {
+    // Blackboxes can come and go between calls, so go again if it didn't fit.
+    var size: usize = 4096;
+    while (true) {
+        const buf = try allocator.alloc(u8, size);
+        errdefer allocator.free(buf);
+        const len = vsh_stats_format_json(buf.ptr, buf.len);
+        if (len < size) {
+            return allocator.realloc(buf, len);
+        }
+        allocator.free(buf);
+        size = len + 1;
+    }
+}
+
+fn fromChunk(comptime T: type, chunk: u32) T {
+    if (T == bool) {
+        return chunk == 1;
+    } else {
+        return @as(T, @intCast(chunk));
+    }
+}
+
 pub fn Object(comptime T: type) type {
     return struct {
         const Self = @This();
@@ -44,11 +250,7 @@ pub fn Object(comptime T: type) type {
         object: *c.cxxrtl_object,
 
         pub fn curr(self: Self) T {
-            if (T == bool) {
-                return self.object.*.curr[0] == 1;
-            } else {
-                return @as(T, @intCast(self.object.*.curr[0]));
-            }
+            return fromChunk(T, self.object.*.curr[0]);
         }
 
         pub fn next(self: Self, value: T) void {
@@ -61,13 +263,56 @@ pub fn Object(comptime T: type) type {
     };
 }
 
+// A set of objects that are read together, once per cycle.  Each field of T
+// is an object of that field's type; snapshot() reads all of them into a T.
+// We hold on to each object's value pointer, so reading them doesn't go through
+// the cxxrtl_object at all.
+//
+// Single-chunk (<= 32 bit) objects only.
+pub fn Ports(comptime T: type) type {
+    const fields = std.meta.fields(T);
+
+    return struct {
+        const Self = @This();
+
+        currs: [fields.len][*]const u32,
+
+        // names is a struct with a field for each of T's, giving the object's
+        // hierarchical name.
+        pub fn init(cxxrtl: Cxxrtl, names: anytype) Self {
+            var self: Self = undefined;
+            inline for (fields, 0..) |field, i| {
+                const name: [:0]const u8 = @field(names, field.name);
+                const object = cxxrtl.get(field.type, name).object;
+                std.debug.assert(object.*.width <= 32);
+                self.currs[i] = object.*.curr;
+            }
+            return self;
+        }
+
+        pub fn snapshot(self: Self) T {
+            var result: T = undefined;
+            inline for (fields, 0..) |field, i| {
+                @field(result, field.name) = fromChunk(field.type, self.currs[i][0]);
+            }
+            return result;
+        }
+    };
+}
+
 pub const Vcd = struct {
     handle: c.cxxrtl_vcd,
     time: u64,
 
-    pub fn init(cxxrtl: Cxxrtl) Vcd {
+    // If scope is given, only objects whose hierarchical names start with it
+    // are traced.
+    pub fn init(cxxrtl: Cxxrtl, scope: ?[:0]const u8) Vcd {
         const handle = c.cxxrtl_vcd_create();
-        c.cxxrtl_vcd_add_from(handle, cxxrtl.handle);
+        if (scope) |s| {
+            c.cxxrtl_vcd_add_from_if(handle, cxxrtl.handle, @constCast(s.ptr), inScope);
+        } else {
+            c.cxxrtl_vcd_add_from(handle, cxxrtl.handle);
+        }
         return .{
             .handle = handle,
             .time = 0,
@@ -78,27 +323,34 @@ pub const Vcd = struct {
         c.cxxrtl_vcd_destroy(self.handle);
     }
 
+    fn inScope(data: ?*anyopaque, name: [*c]const u8, object: [*c]const c.cxxrtl_object) callconv(.C) c_int {
+        _ = object;
+        const scope: [*:0]const u8 = @ptrCast(data.?);
+        return @intFromBool(std.mem.startsWith(u8, std.mem.span(name), std.mem.span(scope)));
+    }
+
     pub fn sample(self: *Vcd) void {
         self.time += 1;
         c.cxxrtl_vcd_sample(self.handle, self.time);
     }
 
-    pub fn read(self: *Vcd, allocator: std.mem.Allocator) ![]u8 {
+    // Advances time without sampling, for stretches we're not tracing.
+    pub fn skip(self: *Vcd) void {
+        self.time += 1;
+    }
+
+    // Writes out and discards everything buffered so far.
+    pub fn drain(self: *Vcd, writer: anytype) !void {
         var data: [*c]const u8 = undefined;
         var size: usize = undefined;
 
-        var buffer = std.ArrayList(u8).init(allocator);
-        errdefer buffer.deinit();
-
         while (true) {
             c.cxxrtl_vcd_read(self.handle, &data, &size);
             if (size == 0) {
                 break;
             }
 
-            try buffer.appendSlice(data[0..size]);
+            try writer.writeAll(data[0..size]);
         }
-
-        return try buffer.toOwnedSlice();
     }
 };
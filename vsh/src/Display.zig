@@ -3,6 +3,7 @@ const gk = @import("gamekit");
 
 const DisplayBase = @import("./DisplayBase.zig");
 const FPGAThread = @import("./FPGAThread.zig");
+const Cxxrtl = @import("./Cxxrtl.zig");
 const SH1107 = @import("./SH1107.zig");
 
 const Display = @This();
@@ -10,6 +11,47 @@ const Display = @This();
 fpga_thread: *FPGAThread,
 base: DisplayBase,
 img: gk.gfx.Texture,
+// Our own SH1107 and GDDRAM, kept up to date from what the FPGA thread
+// publishes; see FPGAThread.drain_display.  GDDRAM is as the FPGA thread
+// keeps it, a byte per column per page.
+sh1107: SH1107 = .{},
+gddram: [FPGAThread.gddram_bytes]u8 = [_]u8{0} ** FPGAThread.gddram_bytes,
+// gddram expanded into texels by expand(), and the look it was expanded with.
+idata: [idata_len]gk.math.Color = [_]gk.math.Color{DisplayBase.black} ** idata_len,
+idata_look: ?Look = null,
+// Frames rendered, and how many of them re-expanded idata, for --report.
+frames: u64 = 0,
+uploads: u64 = 0,
+
+const idata_len = DisplayBase.i2c_width * DisplayBase.i2c_height;
+
+// What, besides GDDRAM, decides the colour of every pixel.
+const Look = struct {
+    reversed: bool,
+    all_on: bool,
+    contrast: u8,
+
+    fn of(sh1107: *const SH1107) Look {
+        return .{
+            .reversed = sh1107.reversed,
+            .all_on = sh1107.all_on,
+            .contrast = sh1107.contrast,
+        };
+    }
+
+    // Lit pixels go from half to full brightness over the contrast range.
+    fn lit(self: Look) gk.math.Color {
+        const black = DisplayBase.black.comps;
+        const white = DisplayBase.white.comps;
+        const scale = @as(u32, 255) + self.contrast;
+        return .{ .comps = .{
+            .r = black.r + @as(u8, @intCast(@as(u32, white.r - black.r) * scale / 510)),
+            .g = black.g + @as(u8, @intCast(@as(u32, white.g - black.g) * scale / 510)),
+            .b = black.b + @as(u8, @intCast(@as(u32, white.b - black.b) * scale / 510)),
+            .a = white.a,
+        } };
+    }
+};
 
 pub fn init() !Display {
     const fpga_thread = try FPGAThread.start();
@@ -24,7 +66,7 @@ pub fn init() !Display {
 }
 
 pub fn deinit(self: Display) void {
-    self.fpga_thread.stop();
+    self.fpga_thread.stop(.{ .frames = self.frames, .uploads = self.uploads });
 }
 
 pub fn update(self: *Display) bool {
@@ -48,11 +90,14 @@ pub fn render(self: *Display) void {
 
     gfx.draw.tex(self.base.voyager2, .{ .x = 0, .y = 0 });
 
-    const sh1107 = self.fpga_thread.acquire_sh1107();
-    self.drawTop(&sh1107);
-    self.drawOLED(&sh1107);
+    if (self.fpga_thread.drain_display(&self.sh1107, &self.gddram)) {
+        self.idata_look = null;
+    }
+    self.drawTop(&self.sh1107);
+    self.drawOLED(&self.sh1107);
 
     gfx.endPass();
+    self.frames += 1;
 }
 
 const TopDrawState = struct {
@@ -151,6 +196,22 @@ const TopDrawState = struct {
         self.left += @as(f32, @floatFromInt(DisplayBase.top_col_width));
         self.top = @as(f32, @floatFromInt(DisplayBase.padding));
     }
+
+    // Moves under the columns, where stats lines go.
+    pub fn stats(self: *TopDrawState) void {
+        self.left = @as(f32, @floatFromInt(DisplayBase.padding));
+        self.top = @as(f32, @floatFromInt(DisplayBase.top_stats_top));
+    }
+
+    pub fn line(self: *TopDrawState, text: []const u8) void {
+        gk.gfx.draw.textOptions(text, self.display.base.fontbook, .{
+            .x = self.left,
+            .y = self.top,
+            .alignment = .left_middle,
+            .color = DisplayBase.white,
+        });
+        self.top += @as(f32, @floatFromInt(DisplayBase.top_row_height));
+    }
 };
 
 fn drawTop(self: *Display, sh1107: *const SH1107) void {
@@ -177,17 +238,63 @@ fn drawTop(self: *Display, sh1107: *const SH1107) void {
     tds.fmt("start", "{x:0>2}", .{sh1107.start_line});
     tds.check("seg remap", sh1107.segment_remap == .Flipped);
     tds.check("com rev", sh1107.com_scan_dir == .Backwards);
+
+    tds.stats();
+    const cycles = self.fpga_thread.sim_cycles.load(.Monotonic);
+    const deltas = self.fpga_thread.sim_deltas.load(.Monotonic);
+    tds.fmt("sim", "{d} cycles, {d:.2} evals/cycle", .{
+        cycles,
+        if (cycles == 0) 0 else @as(f64, @floatFromInt(deltas)) / @as(f64, @floatFromInt(cycles)),
+    });
+
+    var buf: [1024]u8 = undefined;
+    var lines = std.mem.tokenize(u8, Cxxrtl.blackboxStats(&buf), "\n");
+    while (lines.next()) |text| {
+        tds.line(text);
+    }
 }
 
 fn dtStart(self: *Display) void {
     self.base.dtStart();
 }
 
+// Expands gddram into idata, a row of texels from a bit of each byte in a
+// page at a time.
+fn expand(self: *Display, look: Look) void {
+    const lanes = 16;
+    const Bytes = @Vector(lanes, u8);
+    const Texels = @Vector(lanes, u32);
+    comptime std.debug.assert(DisplayBase.i2c_width % lanes == 0);
+
+    const lit: Texels = @splat(look.lit().value);
+    const unlit: Texels = @splat(DisplayBase.black.value);
+    const one: Bytes = @splat(1);
+    const flip: Bytes = @splat(@intFromBool(look.reversed));
+    const force: Bytes = @splat(@intFromBool(look.all_on));
+
+    for (0..FPGAThread.page_count) |page| {
+        const bytes = self.gddram[page * DisplayBase.i2c_width ..][0..DisplayBase.i2c_width];
+        var x: usize = 0;
+        while (x < DisplayBase.i2c_width) : (x += lanes) {
+            const v: Bytes = bytes[x..][0..lanes].*;
+            for (0..8) |bit| {
+                const shift: @Vector(lanes, u3) = @splat(@as(u3, @intCast(bit)));
+                const px = (((v >> shift) & one) ^ flip) | force;
+                const off = (page * 8 + bit) * DisplayBase.i2c_width + x;
+                const out: *[lanes]u32 = @ptrCast(self.idata[off..][0..lanes]);
+                out.* = @select(u32, px == one, lit, unlit);
+            }
+        }
+    }
+}
+
 fn drawOLED(self: *Display, sh1107: *const SH1107) void {
-    if (self.fpga_thread.idata_stale.cmpxchgStrong(true, false, .Acquire, .Monotonic) == null) {
-        self.fpga_thread.idata_mutex.lock();
-        defer self.fpga_thread.idata_mutex.unlock();
-        self.img.setData(gk.math.Color, &self.fpga_thread.idata);
+    const look = Look.of(sh1107);
+    if (self.idata_look == null or !std.meta.eql(self.idata_look.?, look)) {
+        self.expand(look);
+        self.img.setData(gk.math.Color, &self.idata);
+        self.idata_look = look;
+        self.uploads += 1;
     }
 
     if (sh1107.power) {
@@ -207,6 +314,8 @@ fn drawOLED(self: *Display, sh1107: *const SH1107) void {
         const shift = if (sh1107.com_scan_dir == .Backwards) @as(f32, @floatFromInt(DisplayBase.i2c_width)) else 0;
         const display_scale = @as(f32, @floatFromInt(DisplayBase.display_scale));
 
+        // Scrolling only moves where we start reading the texture, wrapping
+        // round to its first row, so it never needs a re-expand or upload.
         const start_line = sh1107.start_line +% sh1107.start_offset;
 
         gk.gfx.draw.texScaleXYRegionAngle(
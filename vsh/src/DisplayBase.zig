@@ -12,7 +12,7 @@ pub const display_scale: u16 = 4;
 pub const border_width: u16 = 4;
 pub const padding: u16 = 10;
 
-pub const top_area: u16 = 112;
+pub const top_area: u16 = 112 + top_stats_rows * top_row_height;
 pub const checkbox_size: u16 = 10;
 pub const checkbox_text_gap: u16 = 6;
 pub const checkbox_across: u16 = 80;
@@ -20,6 +20,13 @@ pub const checkbox_up: u16 = 4;
 
 pub const top_col_width: u16 = 142;
 pub const top_row_height: u16 = 16;
+// Full-width lines under the columns, for the simulation's counters: one of
+// our own, and one for each blackbox or whitebox, of which a design has at
+// most two (I2C and the flash reader).  The window's size is fixed before the
+// design exists, so this can't follow the registry; any more lines than this
+// are still drawn, running on over the display's border.
+pub const top_stats_rows: u16 = 3;
+pub const top_stats_top: u16 = padding + 6 * top_row_height;
 
 ////
 
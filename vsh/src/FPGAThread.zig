@@ -1,87 +1,404 @@
 const std = @import("std");
 const atomic = std.atomic;
-const gk = @import("gamekit");
 
 const main = @import("./main.zig");
 const DisplayBase = @import("./DisplayBase.zig");
 const Cxxrtl = @import("./Cxxrtl.zig");
 const SH1107 = @import("./SH1107.zig");
 const Cmd = @import("./Cmd.zig");
+const Script = @import("./Script.zig");
 
 const SwitchConnector = @import("./SwitchConnector.zig");
 const OLEDConnector = @import("./OLEDConnector.zig");
+const IdleScheduler = @import("./IdleScheduler.zig");
+const Latency = @import("./Latency.zig");
+const Report = @import("./Report.zig");
+const Spsc = @import("./Spsc.zig").Spsc;
 
 const FPGAThread = @This();
 
 thread: std.Thread,
 stop_signal: atomic.Value(bool),
 press_signal: atomic.Value(u8),
-sh1107_mutex: std.Thread.Mutex = .{},
-sh1107: SH1107,
+// Set whenever there's something for a sleeping FPGA thread to wake up for.
+wake: std.Thread.ResetEvent = .{},
+
+// The FPGA thread's own view of the SH1107 and its GDDRAM, a byte per column
+// per page as written.
+sim_sh1107: SH1107 = .{},
+gddram: [gddram_bytes]u8 = [_]u8{0} ** gddram_bytes,
+
+// Where everything fed to sim_sh1107 is sent on to the render thread, if
+// there is one.
+display_queue: ?*DisplayQueue = null,
+
+// Which GDDRAM bytes have been written at least once.  Only meaningful on the
+// FPGA thread; headless runs use it to find the first full frame.
+gddram_written: std.StaticBitSet(gddram_bytes) = std.StaticBitSet(gddram_bytes).initEmpty(),
+gddram_written_count: usize = 0,
+// How many data writes have changed a GDDRAM byte, for Latency, and how many
+// commands sim_sh1107 has carried out, for --report.  FPGA thread only.
+gddram_changes: u64 = 0,
+commands: u64 = 0,
+
+// The SH1107 model inside the design's I2C blackbox or whitebox, if it has
+// one, in which case it stands in for sim_sh1107 and gddram, and the display
+// queue goes unused.  Set once the FPGA thread's built the design.
+model: atomic.Value(?*anyopaque) = atomic.Value(?*anyopaque).init(null),
+// The last model change, and GDDRAM change, drain_display saw.  Only for the
+// render thread.
+model_seen: u64 = 0,
+model_gddram_seen: u64 = 0,
+
+// Published by the FPGA thread every cycle, for the overlay and stats dump.
+sim_cycles: atomic.Value(u64) = atomic.Value(u64).init(0),
+sim_deltas: atomic.Value(u64) = atomic.Value(u64).init(0),
+
+// With main.report, what run() left for stop() to finish and write out.
+report: ?Report = null,
+
+pub const page_count = DisplayBase.i2c_height / 8;
+pub const gddram_bytes = DisplayBase.i2c_width * page_count;
+
+pub const DisplayEvent = union(enum) {
+    Command: Cmd.Command,
+    Data: u8,
+};
 
-idata_mutex: std.Thread.Mutex = .{},
-idata: [DisplayBase.i2c_width * DisplayBase.i2c_height]gk.math.Color = [_]gk.math.Color{DisplayBase.black} ** (DisplayBase.i2c_width * DisplayBase.i2c_height),
-idata_stale: atomic.Value(bool),
+// Carries the commands and data the FPGA thread feeds its SH1107 over to the
+// render thread, which replays them against its own copy.
+//
+// If the render thread falls far enough behind that the ring fills, we stop
+// using it, and keep a snapshot of our SH1107 and GDDRAM up to date under
+// resync_mutex instead.  The render thread throws away what's left in the
+// ring, takes the snapshot, and clears resync, after which we go back to the
+// ring.  The lock's only ever taken while resyncing.
+const DisplayQueue = struct {
+    ring: Spsc(DisplayEvent, 1 << 16) = .{},
+
+    resync: atomic.Value(bool) = atomic.Value(bool).init(false),
+    resync_mutex: std.Thread.Mutex = .{},
+    snapshot_sh1107: SH1107 = .{},
+    snapshot_gddram: [gddram_bytes]u8 = undefined,
+    // How often resync_mutex was taken, and how long we waited for it all
+    // told, for --report.  Only touched with it held.
+    lock_acquisitions: u64 = 0,
+    lock_wait_ns: u64 = 0,
+
+    fn lock(self: *DisplayQueue) void {
+        var timer: ?std.time.Timer = std.time.Timer.start() catch null;
+        self.resync_mutex.lock();
+        self.lock_acquisitions += 1;
+        if (timer) |*t| {
+            self.lock_wait_ns += t.read();
+        }
+    }
+};
 
-pub fn start() !*FPGAThread {
-    var fpga_thread = try std.heap.c_allocator.create(FPGAThread);
-    fpga_thread.* = .{
+fn initial() FPGAThread {
+    return .{
         .thread = undefined,
         .stop_signal = atomic.Value(bool).init(false),
         .press_signal = atomic.Value(u8).init(0),
-        .sh1107 = .{},
-        .idata_stale = atomic.Value(bool).init(true),
     };
+}
+
+pub fn start() !*FPGAThread {
+    var fpga_thread = try std.heap.c_allocator.create(FPGAThread);
+    errdefer std.heap.c_allocator.destroy(fpga_thread);
+    fpga_thread.* = initial();
+
+    const display_queue = try std.heap.c_allocator.create(DisplayQueue);
+    errdefer std.heap.c_allocator.destroy(display_queue);
+    display_queue.* = .{};
+    fpga_thread.display_queue = display_queue;
+
     const thread = try std.Thread.spawn(.{}, run, .{fpga_thread});
     fpga_thread.thread = thread;
     return fpga_thread;
 }
 
-pub fn stop(self: *FPGAThread) void {
+// display is what the render thread did, for --report.
+pub fn stop(self: *FPGAThread, display: Report.Display) void {
     self.stop_signal.store(true, .Monotonic);
+    self.wake.set();
     self.thread.join();
+    if (self.report) |*report| {
+        defer report.deinit(std.heap.c_allocator);
+        const queue = self.display_queue.?;
+        report.display = display;
+        report.lock = .{ .acquisitions = queue.lock_acquisitions, .wait_ns = queue.lock_wait_ns };
+        report.write(main.report.?) catch |err| std.debug.print("writing {s}: {}\n", .{ main.report.?, err });
+    }
+    std.heap.c_allocator.destroy(self.display_queue.?);
     std.heap.c_allocator.destroy(self);
 }
 
-pub fn acquire_sh1107(self: *FPGAThread) SH1107 {
-    self.sh1107_mutex.lock();
-    defer self.sh1107_mutex.unlock();
-    return self.sh1107;
+// Writes the simulation's own counters, then each blackbox's, a line each.
+pub fn dump_stats(self: *const FPGAThread, writer: anytype) !void {
+    const cycles = self.sim_cycles.load(.Monotonic);
+    const deltas = self.sim_deltas.load(.Monotonic);
+    try writer.print("sim: cycles {d} evals {d}\n", .{ cycles, deltas });
+
+    var buf: [4096]u8 = undefined;
+    try writer.writeAll(Cxxrtl.blackboxStats(&buf));
+}
+
+// Runs the simulation on the calling thread for the given number of cycles,
+// without a display, and reports how fast it went.  If press is non-zero, that
+// switch is pressed at the start of the run.
+//
+// The run starts from the checkpoint at main.load_state if set, and if
+// main.save_state is set, we run on until the design's quiet and save one
+// there.
+pub fn run_headless(cycles: u64, press: u8) !void {
+    var gpa = std.heap.GeneralPurposeAllocator(.{}){};
+    defer _ = gpa.deinit();
+
+    const allocator = gpa.allocator();
+
+    var fpga_thread = initial();
+    if (press != 0) {
+        fpga_thread.press_switch_connector(press);
+    }
+
+    var state = try State.init(allocator, &fpga_thread, Cxxrtl.init(), false);
+    defer state.deinit();
+    if (main.load_state) |path| {
+        try state.load_checkpoint(path);
+    }
+    state.settle = main.save_state != null;
+
+    const stats = try state.run(cycles);
+    if (main.save_state) |path| {
+        try state.save_checkpoint(path);
+    }
+
+    const stdout = std.io.getStdOut().writer();
+    const elapsed_s = seconds(stats.elapsed_ns);
+    const khz = @as(f64, @floatFromInt(stats.cycles)) / elapsed_s / 1000;
+    try stdout.print("{d} cycles in {d:.3}s ({d:.1} kHz)\n", .{ stats.cycles, elapsed_s, khz });
+    if (stats.first_full_frame) |fff| {
+        try stdout.print("first full frame at cycle {d} ({d:.3}s)\n", .{ fff.cycle, seconds(fff.elapsed_ns) });
+    } else {
+        try stdout.print("no full frame\n", .{});
+    }
+    try fpga_thread.dump_stats(stdout);
+    if (state.latency) |latency| {
+        try latency.print(stdout);
+    }
+    if (main.report) |path| {
+        const report = try state.report(allocator, stats, .Headless);
+        defer report.deinit(allocator);
+        try report.write(path);
+    }
+}
+
+pub const ScriptResult = struct {
+    cycles: u64,
+    framebuffer: [gddram_bytes]u8,
+    // The framebuffer checksum observed at each of the script's expects, up
+    // to and including the first mismatch.  Owned by the caller.
+    observed: []u32,
+    // With main.trace_latency, the latencies of the script's presses.
+    latency: ?Latency,
+};
+
+// Runs script against a fresh instance of the design on the calling thread,
+// stopping at the first expect that doesn't match unless check is false.
+// Safe to call from several threads at once.
+//
+// If the script names a checkpoint (or main.load_state is set), the design
+// starts from there, and the script's cycles count from it.
+pub fn run_script(allocator: std.mem.Allocator, script: *const Script, check: bool) !ScriptResult {
+    const observed = try allocator.alloc(u32, script.expects.len);
+    errdefer allocator.free(observed);
+
+    var rom_mapping: ?[]align(std.mem.page_size) const u8 = null;
+    if (script.rom) |path| {
+        rom_mapping = try main.mapRom(path);
+    }
+    defer if (rom_mapping) |mapping| std.os.munmap(mapping);
+
+    const rom: ?[]const u8 = if (script.rom == null) null else rom_mapping orelse &.{};
+
+    const fpga_thread = try allocator.create(FPGAThread);
+    defer allocator.destroy(fpga_thread);
+    fpga_thread.* = initial();
+
+    var state = try State.init(allocator, fpga_thread, main.createWithRom(rom), false);
+    defer state.deinit();
+    state.presses = script.presses;
+    state.expects = script.expects;
+    state.observed = observed;
+    state.stop_on_mismatch = check;
+    if (script.state orelse main.load_state) |path| {
+        try state.load_checkpoint(path);
+    }
+
+    const stats = try state.run(script.cycles);
+
+    return .{
+        .cycles = stats.cycles,
+        .framebuffer = fpga_thread.framebuffer(),
+        .observed = try allocator.realloc(observed, state.observed_len),
+        .latency = state.latency,
+    };
+}
+
+// The GDDRAM as the design's written it: a byte per column per page, LSB at
+// the top.
+pub fn framebuffer(self: *const FPGAThread) [gddram_bytes]u8 {
+    if (self.sh1107Model()) |model| {
+        return model.framebuffer().*;
+    }
+    return self.gddram;
+}
+
+// How many GDDRAM bytes have been written at least once.  Only for the FPGA
+// thread.
+fn written_count(self: *const FPGAThread) usize {
+    if (self.sh1107Model()) |model| {
+        return model.writtenCount();
+    }
+    return self.gddram_written_count;
+}
+
+fn change_count(self: *const FPGAThread) u64 {
+    if (self.sh1107Model()) |model| {
+        return model.changedCount();
+    }
+    return self.gddram_changes;
+}
+
+fn command_count(self: *const FPGAThread) u64 {
+    if (self.sh1107Model()) |model| {
+        return model.commandCount();
+    }
+    return self.commands;
+}
+
+fn sh1107Model(self: *const FPGAThread) ?Cxxrtl.SH1107Model {
+    const ptr = self.model.load(.Acquire) orelse return null;
+    return .{ .ptr = ptr };
+}
+
+fn seconds(ns: u64) f64 {
+    return @as(f64, @floatFromInt(ns)) / std.time.ns_per_s;
 }
 
 pub fn press_switch_connector(self: *FPGAThread, which: u8) void {
     self.press_signal.store(which, .Monotonic);
+    self.wake.set();
+}
+
+// Replays everything the FPGA thread's done to its SH1107 since the last call
+// against sh1107 and gddram.  Returns whether gddram changed.  Only for the
+// render thread, and only if we were started with start().
+pub fn drain_display(self: *FPGAThread, sh1107: *SH1107, gddram: *[gddram_bytes]u8) bool {
+    if (self.sh1107Model()) |model| {
+        var regs: Cxxrtl.SH1107Registers = undefined;
+        const gddram_seen = self.model_gddram_seen;
+        if (!model.snapshot(&self.model_seen, &self.model_gddram_seen, &regs, gddram)) {
+            return false;
+        }
+        sh1107.* = SH1107.fromModel(regs);
+        return self.model_gddram_seen != gddram_seen;
+    }
+
+    const queue = self.display_queue.?;
+    var changed = false;
+
+    if (queue.resync.load(.Acquire)) {
+        while (queue.ring.pop()) |_| {}
+
+        queue.lock();
+        defer queue.resync_mutex.unlock();
+
+        sh1107.* = queue.snapshot_sh1107;
+        gddram.* = queue.snapshot_gddram;
+        queue.resync.store(false, .Release);
+        changed = true;
+    }
+
+    while (queue.ring.pop()) |event| {
+        switch (event) {
+            .Command => |cmd| sh1107.cmd(cmd),
+            .Data => |data| {
+                const pxw = sh1107.data(data);
+                gddram[gddram_byte(pxw)] = pxw.value;
+                changed = true;
+            },
+        }
+    }
+
+    return changed;
+}
+
+fn gddram_byte(pxw: SH1107.Write) usize {
+    return @as(usize, pxw.row / 8) * DisplayBase.i2c_width + pxw.column;
 }
 
 pub fn process_cmd(self: *FPGAThread, cmd: Cmd.Command) void {
-    self.sh1107_mutex.lock();
-    defer self.sh1107_mutex.unlock();
-    self.sh1107.cmd(cmd);
+    self.sim_sh1107.cmd(cmd);
+    self.commands += 1;
+    self.publish(.{ .Command = cmd }, null);
 }
 
 pub fn process_data(self: *FPGAThread, data: u8) void {
-    const pxw = pxw: {
-        self.sh1107_mutex.lock();
-        defer self.sh1107_mutex.unlock();
-        break :pxw self.sh1107.data(data);
-    };
+    const pxw = self.sim_sh1107.data(data);
 
-    self.idata_mutex.lock();
-    defer self.idata_mutex.unlock();
-    defer self.idata_stale.store(true, .Release);
-    for (0..8) |i| {
-        const px = ((pxw.value >> @as(u3, @truncate(i))) & 1) == 1;
-        const x = pxw.column;
-        const y = pxw.row + i;
+    const byte = gddram_byte(pxw);
+    if (self.gddram[byte] != pxw.value) {
+        self.gddram_changes += 1;
+    }
+    self.gddram[byte] = pxw.value;
+    if (!self.gddram_written.isSet(byte)) {
+        self.gddram_written.set(byte);
+        self.gddram_written_count += 1;
+    }
+
+    self.publish(.{ .Data = data }, byte);
+}
 
-        const off = y * DisplayBase.i2c_height + x;
-        self.idata[off] = if (px)
-            DisplayBase.white
-        else
-            DisplayBase.black;
+// Sends event on to the render thread, if any, once it's been applied to
+// sim_sh1107 and (for data) gddram[byte].
+fn publish(self: *FPGAThread, event: DisplayEvent, byte: ?usize) void {
+    const queue = self.display_queue orelse return;
+
+    if (!queue.resync.load(.Acquire)) {
+        if (!queue.ring.push(event)) {
+            self.resync_display();
+        }
+        return;
+    }
+
+    queue.lock();
+    defer queue.resync_mutex.unlock();
+    if (queue.resync.load(.Monotonic)) {
+        queue.snapshot_sh1107 = self.sim_sh1107;
+        if (byte) |b| {
+            queue.snapshot_gddram[b] = self.gddram[b];
+        }
+    } else {
+        // The render thread resynced since we looked, emptying the ring.
+        _ = queue.ring.push(event);
     }
 }
 
+// Has the render thread throw away what it's got, and take sim_sh1107 and
+// gddram as they are now.  For when they change other than through
+// process_cmd/process_data.
+fn resync_display(self: *FPGAThread) void {
+    const queue = self.display_queue orelse return;
+
+    queue.lock();
+    defer queue.resync_mutex.unlock();
+    queue.snapshot_sh1107 = self.sim_sh1107;
+    queue.snapshot_gddram = self.gddram;
+    queue.resync.store(true, .Release);
+}
+
 // Called with Thread.spawn.
 fn run(fpga_thread: *FPGAThread) void {
     var gpa = std.heap.GeneralPurposeAllocator(.{}){};
@@ -89,28 +406,74 @@ fn run(fpga_thread: *FPGAThread) void {
 
     const allocator = gpa.allocator();
 
-    var state = State.init(allocator, fpga_thread) catch @panic("State.init threw");
+    var state = State.init(allocator, fpga_thread, Cxxrtl.init(), true) catch @panic("State.init threw");
     defer state.deinit();
+    if (main.load_state) |path| {
+        state.load_checkpoint(path) catch |err| std.debug.panic("loading {s}: {}", .{ path, err });
+    }
 
-    state.run() catch @panic("FPGA thread threw");
+    const stats = state.run(null) catch @panic("FPGA thread threw");
+    // The blackboxes go with the design, so this is the last chance to see
+    // their counters.
+    fpga_thread.dump_stats(std.io.getStdErr().writer()) catch {};
+    if (state.latency) |latency| {
+        latency.print(std.io.getStdErr().writer()) catch {};
+    }
+    if (main.report != null) {
+        fpga_thread.report = state.report(std.heap.c_allocator, stats, .Gui) catch |err| blk: {
+            std.debug.print("making report: {}\n", .{err});
+            break :blk null;
+        };
+    }
 }
 
+const Stats = struct {
+    cycles: u64,
+    elapsed_ns: u64,
+    steps: u64,
+    first_full_frame: ?struct {
+        cycle: u64,
+        elapsed_ns: u64,
+    },
+};
+
 const State = struct {
     fpga_thread: *FPGAThread,
     allocator: std.mem.Allocator,
 
     cxxrtl: Cxxrtl,
     vcd: ?Cxxrtl.Vcd,
+    vcd_file: ?std.fs.File,
 
     switch_connectors: []SwitchConnector,
-    oled_connector: OLEDConnector,
+    // Only when the design has no SH1107 model of its own.
+    oled_connector: ?OLEDConnector,
+    model: ?Cxxrtl.SH1107Model,
+    idle_scheduler: ?IdleScheduler,
+    latency: ?Latency,
+
+    // Scripted switch presses yet to happen, sorted by cycle.
+    presses: []const Script.Press = &.{},
+
+    // Scripted framebuffer checks, and what we saw at each so far.
+    expects: []const Script.Expect = &.{},
+    observed: []u32 = &.{},
+    observed_len: usize = 0,
+    stop_on_mismatch: bool = true,
 
-    fn init(allocator: std.mem.Allocator, fpga_thread: *FPGAThread) !State {
-        const cxxrtl = Cxxrtl.init();
+    // Once max_cycles are up, keep going until a cycle where the design was
+    // quiet, so a checkpoint can be taken there.
+    settle: bool = false,
+
+    // Takes ownership of cxxrtl.
+    fn init(allocator: std.mem.Allocator, fpga_thread: *FPGAThread, cxxrtl: Cxxrtl, schedule_idle: bool) !State {
+        errdefer cxxrtl.deinit();
 
         var vcd: ?Cxxrtl.Vcd = null;
+        var vcd_file: ?std.fs.File = null;
         if (main.write_vcd) {
-            vcd = Cxxrtl.Vcd.init(cxxrtl);
+            vcd = Cxxrtl.Vcd.init(cxxrtl, main.vcd_scope);
+            vcd_file = try std.fs.cwd().createFile("vsh.vcd", .{});
         }
 
         var switch_connectors = std.ArrayList(SwitchConnector).init(allocator);
@@ -129,7 +492,19 @@ const State = struct {
             }
         }
 
-        const oled_connector = OLEDConnector.init(cxxrtl, 0x3c);
+        const model = cxxrtl.sh1107Model();
+        var oled_connector: ?OLEDConnector = null;
+        if (model == null) {
+            oled_connector = OLEDConnector.init(cxxrtl, 0x3c, main.clk_hz, main.i2c_hz);
+        }
+
+        var idle_scheduler: ?IdleScheduler = null;
+        if (schedule_idle) {
+            idle_scheduler = try IdleScheduler.init(cxxrtl, main.clk_hz);
+        }
+
+        const owned_switch_connectors = try switch_connectors.toOwnedSlice();
+        fpga_thread.model.store(if (model) |m| m.ptr else null, .Release);
 
         return .{
             .fpga_thread = fpga_thread,
@@ -137,58 +512,258 @@ const State = struct {
 
             .cxxrtl = cxxrtl,
             .vcd = vcd,
+            .vcd_file = vcd_file,
 
-            .switch_connectors = try switch_connectors.toOwnedSlice(),
+            .switch_connectors = owned_switch_connectors,
             .oled_connector = oled_connector,
+            .model = model,
+            .idle_scheduler = idle_scheduler,
+            .latency = if (main.trace_latency) Latency.init(cxxrtl) else null,
         };
     }
 
     fn deinit(self: *State) void {
+        if (self.vcd) |*vcd| {
+            vcd.deinit();
+        }
+        if (self.vcd_file) |file| {
+            file.close();
+        }
         self.allocator.free(self.switch_connectors);
+        self.fpga_thread.model.store(null, .Release);
+        self.cxxrtl.deinit();
     }
 
-    fn run(self: *State) !void {
-        const clk = self.cxxrtl.get(bool, "clk");
+    // How often we drain the VCD writer's buffer to vsh.vcd.
+    const vcd_flush_cycles = 1 << 16;
+
+    fn sample_vcd(self: *State, cycle: u64) void {
+        if (self.vcd) |*vcd| {
+            if (cycle >= main.vcd_from and (main.vcd_to == null or cycle < main.vcd_to.?)) {
+                vcd.sample();
+            } else {
+                vcd.skip();
+            }
+        }
+    }
+
+    // Takes the framebuffer checksum for any expects due by cycle.  Returns
+    // false if we should stop because one didn't match.
+    fn check_expects(self: *State, cycle: u64) bool {
+        while (self.observed_len < self.expects.len and self.expects[self.observed_len].cycle <= cycle) {
+            const fb = self.fpga_thread.framebuffer();
+            const crc = std.hash.Crc32.hash(&fb);
+            const expected = self.expects[self.observed_len].crc;
+            self.observed[self.observed_len] = crc;
+            self.observed_len += 1;
+            if (crc != expected and self.stop_on_mismatch) {
+                return false;
+            }
+        }
+        return true;
+    }
 
+    fn flush_vcd(self: *State) !void {
         if (self.vcd) |*vcd| {
-            vcd.sample();
+            try vcd.drain(self.vcd_file.?.writer());
         }
+    }
+
+    // Runs until stopped, or until max_cycles have elapsed if given.
+    fn run(self: *State, max_cycles: ?u64) !Stats {
+        const clk = self.cxxrtl.get(bool, "clk");
+        var timer = try std.time.Timer.start();
+        var stats = Stats{ .cycles = 0, .elapsed_ns = 0, .steps = 0, .first_full_frame = null };
+        var deltas: u64 = self.fpga_thread.sim_deltas.load(.Monotonic);
+        var was_quiet = false;
+        // Cycles until the OLED connector's next tick, and what it last said.
+        var oled_countdown: u32 = 0;
+        var oled_quiet = true;
+
+        self.sample_vcd(0);
+
+        while (!self.fpga_thread.stop_signal.load(.Monotonic)) : (stats.cycles += 1) {
+            if (!self.check_expects(stats.cycles)) {
+                break;
+            }
+
+            if (max_cycles) |max| {
+                if (stats.cycles >= max and (!self.settle or was_quiet)) {
+                    break;
+                }
+            }
 
-        while (!self.fpga_thread.stop_signal.load(.Monotonic)) {
             clk.next(true);
 
+            while (self.presses.len > 0 and self.presses[0].cycle <= stats.cycles) : (self.presses = self.presses[1..]) {
+                const which = self.presses[0].which;
+                if (which >= 1 and which <= self.switch_connectors.len) {
+                    self.pressed(self.switch_connectors[which - 1].press(), stats.cycles);
+                }
+            }
+
+            var quiet = true;
             for (self.switch_connectors, 1..) |*swicon, i| {
                 if (self.fpga_thread.press_signal.cmpxchgStrong(@as(u8, @intCast(i)), 0, .Monotonic, .Monotonic) == null) {
-                    swicon.press();
+                    self.pressed(swicon.press(), stats.cycles);
                 }
                 swicon.tick();
+                quiet = quiet and swicon.quiet();
             }
 
-            self.oled_connector.tick(self.fpga_thread);
-            self.cxxrtl.step();
-
-            if (self.vcd) |*vcd| {
-                vcd.sample();
+            if (self.oled_connector) |*oled_connector| {
+                if (oled_countdown == 0) {
+                    oled_connector.tick(self.fpga_thread);
+                    oled_quiet = oled_connector.quiet();
+                    oled_countdown = oled_connector.tick_period;
+                }
+                oled_countdown -= 1;
+            } else {
+                oled_quiet = self.model.?.quiet();
             }
+            quiet = quiet and oled_quiet;
+            if (self.latency) |*latency| {
+                latency.tick(stats.cycles, self.fpga_thread.change_count());
+            }
+            if (stats.first_full_frame == null and self.fpga_thread.written_count() == gddram_bytes) {
+                stats.first_full_frame = .{ .cycle = stats.cycles, .elapsed_ns = timer.read() };
+            }
+            deltas += self.cxxrtl.step();
+            self.sample_vcd(stats.cycles);
 
             clk.next(false);
-            self.cxxrtl.step();
+            deltas += self.cxxrtl.step();
+            self.sample_vcd(stats.cycles);
+            stats.steps += 2;
 
-            if (self.vcd) |*vcd| {
-                vcd.sample();
+            self.fpga_thread.sim_cycles.store(stats.cycles + 1, .Monotonic);
+            self.fpga_thread.sim_deltas.store(deltas, .Monotonic);
+
+            if (stats.cycles % vcd_flush_cycles == vcd_flush_cycles - 1) {
+                try self.flush_vcd();
+            }
+
+            if (self.idle_scheduler) |*idle_scheduler| {
+                idle_scheduler.tick(quiet, &self.fpga_thread.wake);
             }
+            was_quiet = quiet;
         }
+        stats.elapsed_ns = timer.read();
 
-        if (self.vcd) |*vcd| {
-            defer vcd.deinit();
+        try self.flush_vcd();
 
-            const buffer = try vcd.read(self.allocator);
-            defer self.allocator.free(buffer);
+        return stats;
+    }
 
-            var file = try std.fs.cwd().createFile("vsh.vcd", .{});
-            defer file.close();
+    // Everything --report wants that we know of.  The caller fills in the
+    // rest and owns the result.
+    fn report(self: *State, allocator: std.mem.Allocator, stats: Stats, mode: Report.Mode) !Report {
+        return .{
+            .mode = mode,
+            .cycles = stats.cycles,
+            .wall_ns = stats.elapsed_ns,
+            .steps = stats.steps,
+            .deltas = self.fpga_thread.sim_deltas.load(.Monotonic),
+            .commands = self.fpga_thread.command_count(),
+            .i2c = if (self.oled_connector) |oled_connector| .{
+                .transactions = oled_connector.transactions,
+                .bytes = oled_connector.bytes,
+            } else null,
+            .blackboxes = try Cxxrtl.blackboxStatsJson(allocator),
+        };
+    }
+
+    fn pressed(self: *State, took: bool, cycle: u64) void {
+        if (took) {
+            if (self.latency) |*latency| {
+                latency.press(cycle, self.fpga_thread.change_count());
+            }
+        }
+    }
+
+    // A checkpoint is checkpoint_magic and checkpoint_version, then sections
+    // of design values, blackbox state, and our SH1107 and GDDRAM, each
+    // prefixed with its length.  Everything's in native byte order and layout;
+    // a checkpoint's only good for the build that wrote it.
+    //
+    // The connectors' state isn't included, so a checkpoint should be taken
+    // after a quiet cycle, when they've nothing in flight.
+    const checkpoint_magic = "vshstate";
+    const checkpoint_version: u32 = 1;
+
+    fn save_checkpoint(self: *State, path: []const u8) !void {
+        var out = std.ArrayList(u8).init(self.allocator);
+        defer out.deinit();
+
+        try out.appendSlice(checkpoint_magic);
+        try out.writer().writeIntNative(u32, checkpoint_version);
+
+        var start = try beginSection(&out);
+        try self.cxxrtl.saveValues(&out);
+        endSection(&out, start);
+
+        start = try beginSection(&out);
+        try self.cxxrtl.saveBlackboxes(&out);
+        endSection(&out, start);
+
+        const fpga_thread = self.fpga_thread;
+        start = try beginSection(&out);
+        try out.appendSlice(std.mem.asBytes(&fpga_thread.sim_sh1107));
+        try out.appendSlice(&fpga_thread.gddram);
+        try out.appendSlice(std.mem.asBytes(&fpga_thread.gddram_written));
+        try out.appendSlice(std.mem.asBytes(&fpga_thread.gddram_written_count));
+        endSection(&out, start);
+
+        try std.fs.cwd().writeFile(path, out.items);
+    }
+
+    fn load_checkpoint(self: *State, path: []const u8) !void {
+        const in = try std.fs.cwd().readFileAlloc(self.allocator, path, 1 << 30);
+        defer self.allocator.free(in);
+
+        var stream = std.io.fixedBufferStream(in);
+        const reader = stream.reader();
+
+        var magic: [checkpoint_magic.len]u8 = undefined;
+        try reader.readNoEof(&magic);
+        if (!std.mem.eql(u8, &magic, checkpoint_magic) or (try reader.readIntNative(u32)) != checkpoint_version) {
+            return error.BadCheckpoint;
+        }
+
+        try self.cxxrtl.loadValues(self.allocator, try readSection(&stream));
+        try self.cxxrtl.loadBlackboxes(try readSection(&stream));
+
+        const fpga_thread = self.fpga_thread;
+        var display = std.io.fixedBufferStream(try readSection(&stream));
+        try display.reader().readNoEof(std.mem.asBytes(&fpga_thread.sim_sh1107));
+        try display.reader().readNoEof(&fpga_thread.gddram);
+        try display.reader().readNoEof(std.mem.asBytes(&fpga_thread.gddram_written));
+        try display.reader().readNoEof(std.mem.asBytes(&fpga_thread.gddram_written_count));
+        if (display.pos != display.buffer.len or stream.pos != in.len) {
+            return error.BadCheckpoint;
+        }
+
+        // Bring the design's values back in line with what we restored.
+        _ = self.cxxrtl.step();
+        fpga_thread.resync_display();
+    }
+
+    fn beginSection(out: *std.ArrayList(u8)) !usize {
+        try out.appendNTimes(0, @sizeOf(u64));
+        return out.items.len;
+    }
+
+    fn endSection(out: *std.ArrayList(u8), start: usize) void {
+        std.mem.writeIntNative(u64, out.items[start - @sizeOf(u64) ..][0..@sizeOf(u64)], out.items.len - start);
+    }
 
-            try file.writeAll(buffer);
+    fn readSection(stream: *std.io.FixedBufferStream([]const u8)) ![]const u8 {
+        const len = try stream.reader().readIntNative(u64);
+        if (len > stream.buffer.len - stream.pos) {
+            return error.BadCheckpoint;
         }
+        const section = stream.buffer[stream.pos..][0..@as(usize, @intCast(len))];
+        stream.pos += len;
+        return section;
     }
 };
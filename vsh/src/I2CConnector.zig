@@ -10,34 +10,47 @@ addr: u7,
 byte_transmitter: ByteTransmitter = .{},
 addressed: bool = false,
 
+ports: Cxxrtl.Ports(Ports),
+
 scl_o: Sample(bool),
 scl_oe: Sample(bool),
 sda_o: Sample(bool),
 sda_oe: Sample(bool),
 sda_i: Cxxrtl.Object(bool),
 
+const Ports = struct {
+    scl_o: bool,
+    scl_oe: bool,
+    sda_o: bool,
+    sda_oe: bool,
+};
+
 pub fn init(cxxrtl: Cxxrtl, addr: u7) @This() {
-    const scl_o = Sample(bool).init(cxxrtl, "hw_bus__scl_o", false);
-    const scl_oe = Sample(bool).init(cxxrtl, "hw_bus__scl_oe", false);
-    const sda_o = Sample(bool).init(cxxrtl, "hw_bus__sda_o", false);
-    const sda_oe = Sample(bool).init(cxxrtl, "hw_bus__sda_oe", false);
+    const ports = Cxxrtl.Ports(Ports).init(cxxrtl, .{
+        .scl_o = "hw_bus__scl_o",
+        .scl_oe = "hw_bus__scl_oe",
+        .sda_o = "hw_bus__sda_o",
+        .sda_oe = "hw_bus__sda_oe",
+    });
     const sda_i = cxxrtl.get(bool, "hw_bus__sda_i");
 
     return .{
         .addr = addr,
-        .scl_o = scl_o,
-        .scl_oe = scl_oe,
-        .sda_o = sda_o,
-        .sda_oe = sda_oe,
+        .ports = ports,
+        .scl_o = Sample(bool).init(false),
+        .scl_oe = Sample(bool).init(false),
+        .sda_o = Sample(bool).init(false),
+        .sda_oe = Sample(bool).init(false),
         .sda_i = sda_i,
     };
 }
 
 pub fn tick(self: *@This()) Tick {
-    const scl_o = self.scl_o.tick();
-    const scl_oe = self.scl_oe.tick();
-    const sda_o = self.sda_o.tick();
-    const sda_oe = self.sda_oe.tick();
+    const ports = self.ports.snapshot();
+    const scl_o = self.scl_o.update(ports.scl_o);
+    const scl_oe = self.scl_oe.update(ports.scl_oe);
+    const sda_o = self.sda_o.update(ports.sda_o);
+    const sda_oe = self.sda_oe.update(ports.sda_oe);
 
     const result = self.byte_transmitter.process(scl_o, scl_oe, sda_o, sda_oe);
     switch (result) {
@@ -95,6 +108,29 @@ pub fn tick(self: *@This()) Tick {
     }
 }
 
+// How many design cycles we can leave between ticks without missing anything.
+// The I2C controller only moves the bus on its counter's half and full
+// strobes (and once on leaving IDLE, a whole count before the next), which a
+// counter of max cycles puts at least max - 1 - max / 2 apart.  Looking at
+// least that often, we see each change on its own and in order, and answer
+// the controller's reads well within the half bit it gives us.
+pub fn tickPeriod(clk_hz: u64, i2c_hz: u64) u32 {
+    const max = clk_hz / (i2c_hz * 2);
+    if (max < 2) {
+        return 1;
+    }
+    return @as(u32, @intCast(@max(max - 1 - max / 2, 1)));
+}
+
+// Whether the bus has been left alone since the last tick.
+pub fn quiet(self: @This()) bool {
+    return !self.addressed and
+        self.scl_o.stable() and
+        self.scl_oe.stable() and
+        self.sda_o.stable() and
+        self.sda_oe.stable();
+}
+
 pub fn reset(self: *@This()) void {
     self.addressed = false;
 }
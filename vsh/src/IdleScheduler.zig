@@ -0,0 +1,88 @@
+const std = @import("std");
+
+const Cxxrtl = @import("./Cxxrtl.zig");
+
+// Keeps the FPGA thread from spinning flat out while the design has nothing to
+// do.  Once the OLED connector has seen no I²C activity and the flash reader's
+// been idle for quiet_threshold cycles, we consider the design quiet:
+//
+// * If the cursor blink counter (the only timer the design runs while waiting
+//   on input) is off, nothing can happen until a switch is pressed, so we
+//   sleep until woken.
+// * Otherwise, if we know the clock frequency, we pace the simulation to real
+//   time, so the blink happens when it would on the real thing without us
+//   racing ahead.  Pacing only ever slows us down: a build that simulates
+//   slower than real time still runs flat out while the cursor blinks.
+//
+// Jumping the counter ahead instead would mean poking at the design's internal
+// state, so we don't.
+const IdleScheduler = @This();
+
+const quiet_threshold = 65536;
+
+spifr_busy: ?Cxxrtl.Object(bool),
+cursor_en: ?Cxxrtl.Object(bool),
+
+pace_batch: ?u64,
+pace_batch_ns: u64,
+timer: std.time.Timer,
+
+quiet_cycles: u64 = 0,
+
+pub fn init(cxxrtl: Cxxrtl, clk_hz: ?u64) !IdleScheduler {
+    const pace_batch = if (clk_hz) |hz| @max(hz / 1000, 1) else null;
+    return .{
+        .spifr_busy = cxxrtl.find(bool, "oled spifr busy"),
+        .cursor_en = cxxrtl.find(bool, "oled _cursor_en"),
+        .pace_batch = pace_batch,
+        .pace_batch_ns = if (clk_hz) |hz| pace_batch.? * std.time.ns_per_s / hz else 0,
+        .timer = try std.time.Timer.start(),
+    };
+}
+
+// Call once per cycle.  quiet is whether the connectors saw any activity this
+// cycle; wake is set when there's new input (or we're being stopped).
+pub fn tick(self: *IdleScheduler, quiet: bool, wake: *std.Thread.ResetEvent) void {
+    if (!quiet or (self.spifr_busy != null and self.spifr_busy.?.curr())) {
+        self.quiet_cycles = 0;
+        return;
+    }
+
+    self.quiet_cycles += 1;
+    if (self.quiet_cycles < quiet_threshold) {
+        // Clear anything wake was left with from a press we've dealt with
+        // already, a cycle ahead of our first wait, so it doesn't return at
+        // once.  A press after this sets it again, and is seen next cycle.
+        if (self.quiet_cycles == quiet_threshold - 1) {
+            wake.reset();
+        }
+        return;
+    }
+
+    if (self.cursor_en) |cursor_en| {
+        if (!cursor_en.curr()) {
+            wake.wait();
+            wake.reset();
+            self.quiet_cycles = 0;
+            return;
+        }
+    }
+
+    const pace_batch = self.pace_batch orelse return;
+    if (self.quiet_cycles == quiet_threshold) {
+        self.timer.reset();
+        return;
+    }
+    if ((self.quiet_cycles - quiet_threshold) % pace_batch != 0) {
+        return;
+    }
+
+    const elapsed_ns = self.timer.read();
+    if (elapsed_ns < self.pace_batch_ns) {
+        if (wake.timedWait(self.pace_batch_ns - elapsed_ns)) {
+            wake.reset();
+            self.quiet_cycles = 0;
+        } else |_| {}
+    }
+    self.timer.reset();
+}
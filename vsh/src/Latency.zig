@@ -0,0 +1,156 @@
+const std = @import("std");
+
+const Cxxrtl = @import("./Cxxrtl.zig");
+
+// Measures how long the design takes to respond to a switch press, in
+// design cycles: until the I2C controller is first strobed, until the first
+// data byte (not a START) goes into its FIFO, and until a write first changes
+// a GDDRAM byte.  Only one press is traced at a time; a press that comes while
+// one's still waiting on its pixel change ends that trace incomplete.
+//
+// The strobe and FIFO stages need the design to expose the OLED's I2C bus;
+// without them only the pixel stage is measured.
+const Latency = @This();
+
+pub const Stage = enum {
+    Stb,
+    Byte,
+    Pixel,
+
+    fn str(self: Stage) []const u8 {
+        return switch (self) {
+            .Stb => "press to stb",
+            .Byte => "press to first byte",
+            .Pixel => "press to pixel",
+        };
+    }
+};
+
+// Latencies, counted into power-of-two buckets: bucket i holds those in
+// [2^(i-1), 2^i), and bucket 0 holds zero.
+pub const Histogram = struct {
+    const bucket_count = 65;
+
+    buckets: [bucket_count]u64 = [_]u64{0} ** bucket_count,
+    count: u64 = 0,
+    sum: u64 = 0,
+    min: u64 = std.math.maxInt(u64),
+    max: u64 = 0,
+
+    fn add(self: *Histogram, cycles: u64) void {
+        self.buckets[64 - @as(usize, @clz(cycles))] += 1;
+        self.count += 1;
+        self.sum +|= cycles;
+        self.min = @min(self.min, cycles);
+        self.max = @max(self.max, cycles);
+    }
+
+    fn merge(self: *Histogram, other: Histogram) void {
+        for (&self.buckets, other.buckets) |*bucket, count| {
+            bucket.* += count;
+        }
+        self.count += other.count;
+        self.sum +|= other.sum;
+        self.min = @min(self.min, other.min);
+        self.max = @max(self.max, other.max);
+    }
+
+    fn print(self: Histogram, writer: anytype, name: []const u8) !void {
+        if (self.count == 0) {
+            try writer.print("  {s}: none\n", .{name});
+            return;
+        }
+
+        try writer.print("  {s}: {d} samples, min {d}, mean {d}, max {d} cycles\n", .{
+            name,
+            self.count,
+            self.min,
+            self.sum / self.count,
+            self.max,
+        });
+        for (self.buckets, 0..) |count, i| {
+            if (count == 0) {
+                continue;
+            }
+            const low: u64 = if (i == 0) 0 else @as(u64, 1) << @as(u6, @intCast(i - 1));
+            const high: u64 = if (i == 0) 1 else low *| 2;
+            try writer.print("    [{d}, {d}): {d}\n", .{ low, high, count });
+        }
+    }
+};
+
+stb: ?Cxxrtl.Object(bool),
+w_en: ?Cxxrtl.Object(bool),
+w_data: ?Cxxrtl.Object(u16),
+
+histograms: std.enums.EnumArray(Stage, Histogram) = std.enums.EnumArray(Stage, Histogram).initFill(.{}),
+incomplete: u64 = 0,
+
+// The open trace, if any: when its press was, which stages it's seen, and
+// how many GDDRAM changes there had been by then.
+pressed_at: ?u64 = null,
+seen: std.enums.EnumSet(Stage) = std.enums.EnumSet(Stage).initEmpty(),
+changes_at_press: u64 = 0,
+
+pub fn init(cxxrtl: Cxxrtl) Latency {
+    return .{
+        .stb = cxxrtl.find(bool, "oled i2c_bus__stb"),
+        .w_en = cxxrtl.find(bool, "oled i2c_bus__in_fifo_w_en"),
+        .w_data = cxxrtl.find(u16, "oled i2c_bus__in_fifo_w_data"),
+    };
+}
+
+// A switch was pressed on cycle, after changes GDDRAM changes.
+pub fn press(self: *Latency, cycle: u64, changes: u64) void {
+    if (self.pressed_at != null) {
+        self.incomplete += 1;
+    }
+    self.pressed_at = cycle;
+    self.seen = std.enums.EnumSet(Stage).initEmpty();
+    self.changes_at_press = changes;
+}
+
+// Call once per cycle, with the number of GDDRAM changes so far.
+pub fn tick(self: *Latency, cycle: u64, changes: u64) void {
+    const pressed_at = self.pressed_at orelse return;
+
+    if (self.stb) |stb| {
+        if (stb.curr()) {
+            self.record(.Stb, cycle - pressed_at);
+        }
+    }
+    if (self.w_en) |w_en| {
+        if (w_en.curr() and (self.w_data.?.curr() & 0x100) == 0) {
+            self.record(.Byte, cycle - pressed_at);
+        }
+    }
+    if (changes != self.changes_at_press) {
+        self.record(.Pixel, cycle - pressed_at);
+        self.pressed_at = null;
+    }
+}
+
+fn record(self: *Latency, stage: Stage, cycles: u64) void {
+    if (!self.seen.contains(stage)) {
+        self.seen.insert(stage);
+        self.histograms.getPtr(stage).add(cycles);
+    }
+}
+
+pub fn merge(self: *Latency, other: Latency) void {
+    inline for (comptime std.enums.values(Stage)) |stage| {
+        self.histograms.getPtr(stage).merge(other.histograms.get(stage));
+    }
+    self.incomplete += other.incomplete + @intFromBool(other.pressed_at != null);
+}
+
+pub fn print(self: Latency, writer: anytype) !void {
+    const incomplete = self.incomplete + @intFromBool(self.pressed_at != null);
+    try writer.print("latency: {d} traced to a pixel change, {d} incomplete\n", .{
+        self.histograms.get(.Pixel).count,
+        incomplete,
+    });
+    inline for (comptime std.enums.values(Stage)) |stage| {
+        try self.histograms.get(stage).print(writer, stage.str());
+    }
+}
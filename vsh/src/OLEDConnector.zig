@@ -2,18 +2,20 @@ const std = @import("std");
 
 const Cxxrtl = @import("./Cxxrtl.zig");
 const I2CConnector = @import("./I2CConnector.zig");
-const I2CBBConnector = @import("./I2CBBConnector.zig");
 const FPGAThread = @import("./FPGAThread.zig");
 const Cmd = @import("./Cmd.zig");
 
 const OLEDConnector = @This();
 
-const InnerI2CConnector = union(enum) {
-    I2CConnector: I2CConnector,
-    I2CBBConnector: I2CBBConnector,
-};
-
-i2c_connector: InnerI2CConnector,
+// Decodes the bus at the hw_bus ports.  Designs with the I2C blackbox or
+// whitebox don't need us: the SH1107 model inside it does our job.
+i2c_connector: I2CConnector,
+// Tick every this many design cycles.
+tick_period: u32 = 1,
+// What we've decoded, for --report: transactions addressed to us, and the
+// bytes written in them.
+transactions: u64 = 0,
+bytes: u64 = 0,
 
 state: union(enum) {
     Unaddressed,
@@ -40,74 +42,80 @@ pub fn tick(self: *OLEDConnector, fpga_thread: *FPGAThread) void {
 }
 
 fn tick_i2c(self: *OLEDConnector, fpga_thread: *FPGAThread) void {
-    switch (self.i2c_connector) {
-        inline else => |*i2c_connector| {
-            switch (i2c_connector.tick()) {
-                .Pass => {},
-                .AddressedWrite => {
-                    self.state = .{ .AddressedWrite = .{} };
-                },
-                .AddressedRead => |byte_out| {
-                    self.state = .AddressedRead;
-                    const sh1107 = fpga_thread.acquire_sh1107();
+    const i2c_connector = &self.i2c_connector;
+    switch (i2c_connector.tick()) {
+        .Pass => {},
+        .AddressedWrite => {
+            self.state = .{ .AddressedWrite = .{} };
+            self.transactions += 1;
+        },
+        .AddressedRead => |byte_out| {
+            self.state = .AddressedRead;
+            self.transactions += 1;
+            const sh1107 = fpga_thread.sim_sh1107;
 
-                    // not busy, display on/off, ID=7
-                    byte_out.* = 0x07 | (if (sh1107.power) @as(u8, 0x00) else @as(u8, 0x40));
-                },
-                .Error => {
-                    std.debug.print("i2c error\n", .{});
-                    self.state = .Unaddressed;
-                },
-                .Fish => {
-                    switch (self.state) {
-                        .Unaddressed => std.debug.print("i2c fish while unaddressed\n", .{}),
-                        .AddressedWrite => |parser| if (!parser.valid_finish) {
-                            std.debug.print("i2c fish without valid_finish\n", .{});
-                        },
-                        .AddressedRead => {},
-                    }
-                    self.state = .Unaddressed;
+            // not busy, display on/off, ID=7
+            byte_out.* = 0x07 | (if (sh1107.power) @as(u8, 0x00) else @as(u8, 0x40));
+        },
+        .Error => {
+            std.debug.print("i2c error\n", .{});
+            self.state = .Unaddressed;
+        },
+        .Fish => {
+            switch (self.state) {
+                .Unaddressed => std.debug.print("i2c fish while unaddressed\n", .{}),
+                .AddressedWrite => |parser| if (!parser.valid_finish) {
+                    std.debug.print("i2c fish without valid_finish\n", .{});
                 },
-                .Byte => |byte| {
-                    switch (self.state) {
-                        .AddressedWrite => |*parser| switch (parser.feed(byte)) {
-                            .Pass => {},
-                            .Unrecoverable => {
-                                std.debug.print("command parser noped out, fed {x:0>2} -- " ++
-                                    "state: {} / continuation: {} / partial_cmd: {?x:0>2}\n", .{
-                                    byte,
-                                    parser.state,
-                                    parser.continuation,
-                                    parser.partial_cmd,
-                                });
-                                self.state = .Unaddressed;
-                                i2c_connector.reset();
-                            },
-                            .Command => |cmd| {
-                                fpga_thread.process_cmd(cmd);
-                            },
-                            .Data => |data| {
-                                fpga_thread.process_data(data);
-                            },
-                        },
-                        else => std.debug.print("i2c got Byte while not AddressedWrite\n", .{}),
-                    }
+                .AddressedRead => {},
+            }
+            self.state = .Unaddressed;
+        },
+        .Byte => |byte| {
+            if (self.state == .AddressedWrite) {
+                self.bytes += 1;
+            }
+            switch (self.state) {
+                .AddressedWrite => |*parser| switch (parser.feed(byte)) {
+                    .Pass => {},
+                    .Unrecoverable => {
+                        std.debug.print("command parser noped out, fed {x:0>2} -- " ++
+                            "state: {} / continuation: {} / partial_cmd: {?x:0>2}\n", .{
+                            byte,
+                            parser.state,
+                            parser.continuation,
+                            parser.partial_cmd,
+                        });
+                        self.state = .Unaddressed;
+                        i2c_connector.reset();
+                    },
+                    .Command => |cmd| {
+                        fpga_thread.process_cmd(cmd);
+                    },
+                    .Data => |data| {
+                        fpga_thread.process_data(data);
+                    },
                 },
+                else => std.debug.print("i2c got Byte while not AddressedWrite\n", .{}),
             }
         },
     }
 }
 
-pub fn init(cxxrtl: Cxxrtl, addr: u7) OLEDConnector {
-    var i2c_connector: InnerI2CConnector = undefined;
+pub fn quiet(self: OLEDConnector) bool {
+    return self.state == .Unaddressed and self.i2c_connector.quiet();
+}
 
-    if (cxxrtl.find(bool, "hw_bus__scl_o") != null) {
-        i2c_connector = .{ .I2CConnector = I2CConnector.init(cxxrtl, addr) };
-    } else {
-        i2c_connector = .{ .I2CBBConnector = I2CBBConnector.init(cxxrtl, addr) };
+// With clk_hz and i2c_hz both known, we only tick as often as the bus can
+// change.
+pub fn init(cxxrtl: Cxxrtl, addr: u7, clk_hz: ?u64, i2c_hz: ?u64) OLEDConnector {
+    var tick_period: u32 = 1;
+    if (clk_hz != null and i2c_hz != null) {
+        tick_period = I2CConnector.tickPeriod(clk_hz.?, i2c_hz.?);
     }
 
     return .{
-        .i2c_connector = i2c_connector,
+        .i2c_connector = I2CConnector.init(cxxrtl, addr),
+        .tick_period = tick_period,
     };
 }
@@ -0,0 +1,102 @@
+const std = @import("std");
+
+// What --report writes at the end of a headless or GUI run: one JSON object,
+// for dashboards to keep an eye on simulation speed from commit to commit.
+// Fields are only ever added; version goes up if one changes meaning.
+const Report = @This();
+
+pub const version = 1;
+
+pub const Mode = enum {
+    Headless,
+    Gui,
+
+    fn str(self: Mode) []const u8 {
+        return switch (self) {
+            .Headless => "headless",
+            .Gui => "gui",
+        };
+    }
+};
+
+pub const I2C = struct {
+    transactions: u64,
+    bytes: u64,
+};
+
+pub const Display = struct {
+    frames: u64,
+    // Frames that re-expanded GDDRAM into the texture and uploaded it.
+    uploads: u64,
+};
+
+pub const Lock = struct {
+    acquisitions: u64,
+    wait_ns: u64,
+};
+
+mode: Mode,
+cycles: u64,
+wall_ns: u64,
+// Calls to cxxrtl_step, and the delta cycles they took all told.
+steps: u64,
+deltas: u64,
+// Commands carried out by the SH1107 the FPGA thread feeds.
+commands: u64,
+// Only when vsh decoded the bus itself, in OLEDConnector.
+i2c: ?I2C = null,
+// Only for GUI runs: what the render thread did, and how long the two
+// threads waited on each other for a display resync.
+display: ?Display = null,
+lock: ?Lock = null,
+// Cxxrtl.blackboxStatsJson's, owned.
+blackboxes: []const u8,
+
+pub fn deinit(self: Report, allocator: std.mem.Allocator) void {
+    allocator.free(self.blackboxes);
+}
+
+pub fn write(self: Report, path: []const u8) !void {
+    const file = try std.fs.cwd().createFile(path, .{});
+    defer file.close();
+
+    var buffered = std.io.bufferedWriter(file.writer());
+    try self.writeJson(buffered.writer());
+    try buffered.flush();
+}
+
+fn writeJson(self: Report, writer: anytype) !void {
+    const khz = if (self.wall_ns == 0) 0 else @as(f64, @floatFromInt(self.cycles)) * std.time.ns_per_ms / @as(f64, @floatFromInt(self.wall_ns));
+
+    try writer.print("{{\"version\":{d},\"mode\":\"{s}\",\"cycles\":{d},\"wall_ns\":{d},\"khz\":{d:.3}", .{
+        version,
+        self.mode.str(),
+        self.cycles,
+        self.wall_ns,
+        khz,
+    });
+    try writer.print(",\"steps\":{d},\"deltas\":{d},\"commands\":{d}", .{ self.steps, self.deltas, self.commands });
+
+    try writer.writeAll(",\"i2c\":");
+    if (self.i2c) |i2c| {
+        try writer.print("{{\"transactions\":{d},\"bytes\":{d}}}", .{ i2c.transactions, i2c.bytes });
+    } else {
+        try writer.writeAll("null");
+    }
+
+    try writer.writeAll(",\"display\":");
+    if (self.display) |display| {
+        try writer.print("{{\"frames\":{d},\"uploads\":{d}}}", .{ display.frames, display.uploads });
+    } else {
+        try writer.writeAll("null");
+    }
+
+    try writer.writeAll(",\"lock\":");
+    if (self.lock) |lock| {
+        try writer.print("{{\"acquisitions\":{d},\"wait_ns\":{d}}}", .{ lock.acquisitions, lock.wait_ns });
+    } else {
+        try writer.writeAll("null");
+    }
+
+    try writer.print(",\"blackboxes\":{s}}}\n", .{self.blackboxes});
+}
@@ -0,0 +1,117 @@
+const std = @import("std");
+
+const FPGAThread = @import("./FPGAThread.zig");
+const Latency = @import("./Latency.zig");
+const Script = @import("./Script.zig");
+
+// Runs each script against its own instance of the design, spread over a
+// thread pool, and reports each one's final framebuffer checksum in order.
+// If fb_out is given, the framebuffers are also written there as
+// <script basename>.fb, in GDDRAM layout.
+//
+// Each script's expects are checked as it runs, and a script stops at its
+// first mismatch.  With bless, nothing's checked; instead we print expect
+// lines matching what we saw, for pasting into the script.
+const Runner = @This();
+
+const Outcome = union(enum) {
+    Pending,
+    Ok: FPGAThread.ScriptResult,
+    Failed: anyerror,
+};
+
+pub fn run(allocator: std.mem.Allocator, paths: []const []const u8, jobs: ?u32, fb_out: ?[]const u8, bless: bool) !bool {
+    const scripts = try allocator.alloc(Script, paths.len);
+    defer allocator.free(scripts);
+
+    var loaded: usize = 0;
+    defer for (scripts[0..loaded]) |script| script.deinit();
+    for (paths) |path| {
+        scripts[loaded] = try Script.load(allocator, path);
+        loaded += 1;
+    }
+
+    const outcomes = try allocator.alloc(Outcome, scripts.len);
+    defer allocator.free(outcomes);
+    @memset(outcomes, .Pending);
+    defer for (outcomes) |outcome| switch (outcome) {
+        .Ok => |result| allocator.free(result.observed),
+        else => {},
+    };
+
+    {
+        var pool: std.Thread.Pool = undefined;
+        try pool.init(.{ .allocator = allocator, .n_jobs = jobs });
+        defer pool.deinit();
+
+        var wg: std.Thread.WaitGroup = .{};
+        for (scripts, outcomes) |*script, *outcome| {
+            wg.start();
+            try pool.spawn(worker, .{ allocator, script, !bless, outcome, &wg });
+        }
+        wg.wait();
+    }
+
+    const stdout = std.io.getStdOut().writer();
+    var ok = true;
+    var latency: ?Latency = null;
+    for (scripts, outcomes) |script, outcome| {
+        switch (outcome) {
+            .Pending => unreachable,
+            .Ok => |result| {
+                if (result.latency) |l| {
+                    if (latency) |*all| {
+                        all.merge(l);
+                    } else {
+                        latency = l;
+                    }
+                }
+
+                const crc = std.hash.Crc32.hash(&result.framebuffer);
+                try stdout.print("{s}: {d} cycles, framebuffer {x:0>8}\n", .{ script.path, result.cycles, crc });
+                if (fb_out) |dir| {
+                    try writeFramebuffer(allocator, dir, script.path, &result.framebuffer);
+                }
+
+                for (script.expects[0..result.observed.len], result.observed) |expect, observed| {
+                    if (bless) {
+                        try stdout.print("expect {d} {x:0>8}\n", .{ expect.cycle, observed });
+                    } else if (observed != expect.crc) {
+                        try stdout.print("{s}: mismatch at cycle {d}: expected {x:0>8}, got {x:0>8}\n", .{ script.path, expect.cycle, expect.crc, observed });
+                        ok = false;
+                    }
+                }
+            },
+            .Failed => |err| {
+                try stdout.print("{s}: failed: {s}\n", .{ script.path, @errorName(err) });
+                ok = false;
+            },
+        }
+    }
+
+    if (latency) |all| {
+        try all.print(stdout);
+    }
+
+    return ok;
+}
+
+fn worker(allocator: std.mem.Allocator, script: *const Script, check: bool, outcome: *Outcome, wg: *std.Thread.WaitGroup) void {
+    defer wg.finish();
+
+    if (FPGAThread.run_script(allocator, script, check)) |result| {
+        outcome.* = .{ .Ok = result };
+    } else |err| {
+        outcome.* = .{ .Failed = err };
+    }
+}
+
+fn writeFramebuffer(allocator: std.mem.Allocator, dir: []const u8, script_path: []const u8, fb: []const u8) !void {
+    const name = try std.fmt.allocPrint(allocator, "{s}.fb", .{std.fs.path.stem(script_path)});
+    defer allocator.free(name);
+
+    var out_dir = try std.fs.cwd().makeOpenPath(dir, .{});
+    defer out_dir.close();
+
+    try out_dir.writeFile(name, fb);
+}
@@ -2,6 +2,7 @@ const std = @import("std");
 const gk = @import("gamekit");
 
 const Cmd = @import("./Cmd.zig");
+const Cxxrtl = @import("./Cxxrtl.zig");
 
 pub const DclkFreq = enum(u4) {
     Neg25 = 0b000,
@@ -88,6 +89,30 @@ pub fn init() @This() {
     return .{};
 }
 
+// The state of the design's own SH1107 model, for display.
+pub fn fromModel(r: Cxxrtl.SH1107Registers) @This() {
+    return .{
+        .power = r.power,
+        .dcdc = r.dcdc,
+        .dclk_freq = @as(DclkFreq, @enumFromInt(@as(u4, @truncate(r.dclk_freq)))),
+        .dclk_ratio = r.dclk_ratio,
+        .precharge_period = @as(u4, @truncate(r.precharge_period)),
+        .discharge_period = @as(u4, @truncate(r.discharge_period)),
+        .vcom_desel = r.vcom_desel,
+        .all_on = r.all_on,
+        .reversed = r.reversed,
+        .contrast = r.contrast,
+        .start_line = @as(u7, @truncate(r.start_line)),
+        .start_offset = @as(u7, @truncate(r.start_offset)),
+        .page_address = @as(u4, @truncate(r.page_address)),
+        .column_address = @as(u7, @truncate(r.column_address)),
+        .addressing_mode = @as(AddrMode, @enumFromInt(@as(u1, @truncate(r.addressing_mode)))),
+        .multiplex = r.multiplex,
+        .segment_remap = @as(SegRemap, @enumFromInt(@as(u1, @truncate(r.segment_remap)))),
+        .com_scan_dir = @as(COMScanDir, @enumFromInt(@as(u1, @truncate(r.com_scan_dir)))),
+    };
+}
+
 pub fn cmd(self: *@This(), c: Cmd.Command) void {
     switch (c) {
         .SetLowerColumnAddress => |lower| {
@@ -155,7 +180,7 @@ pub fn cmd(self: *@This(), c: Cmd.Command) void {
     }
 }
 
-const Write = struct {
+pub const Write = struct {
     column: u7,
     row: u7,
     value: u8,
@@ -1,26 +1,24 @@
 const std = @import("std");
 
-const Cxxrtl = @import("./Cxxrtl.zig");
-
+// The current and previous values of a port, as fed to update() once per cycle
+// (typically from a Cxxrtl.Ports snapshot).
 pub fn Sample(comptime T: type) type {
     return struct {
         const Self = @This();
 
-        object: Cxxrtl.Object(T),
         prev: T,
         curr: T,
 
-        pub fn init(cxxrtl: Cxxrtl, name: [:0]const u8, start: T) Self {
+        pub fn init(start: T) Self {
             return .{
-                .object = cxxrtl.get(T, name),
                 .prev = start,
                 .curr = start,
             };
         }
 
-        pub fn tick(self: *Self) *Self {
+        pub fn update(self: *Self, value: T) *Self {
             self.prev = self.curr;
-            self.curr = self.object.curr();
+            self.curr = value;
             return self;
         }
 
@@ -0,0 +1,211 @@
+const std = @import("std");
+
+// A stimulus script for headless runs.  One directive per line; blank lines
+// and anything after a '#' are ignored.
+//
+//   cycles N          run for N cycles (required)
+//   rom PATH          map this flash image for the run, relative to the script
+//   state PATH        start from this checkpoint (see vsh --save-state),
+//                     relative to the script; cycles then count from there
+//   press CYCLE N     press switch N (as numbered on the keyboard) at CYCLE
+//   expect CYCLE CRC  after CYCLE cycles, the framebuffer's CRC-32 (in hex)
+//                     should be CRC; CYCLE can't be past the script's cycles
+const Script = @This();
+
+pub const Press = struct {
+    cycle: u64,
+    which: u8,
+};
+
+pub const Expect = struct {
+    cycle: u64,
+    crc: u32,
+};
+
+allocator: std.mem.Allocator,
+path: []const u8,
+cycles: u64,
+rom: ?[]const u8,
+state: ?[]const u8,
+// Both sorted by cycle.
+presses: []const Press,
+expects: []const Expect,
+
+pub fn load(allocator: std.mem.Allocator, path: []const u8) !Script {
+    const source = try std.fs.cwd().readFileAlloc(allocator, path, 1 << 20);
+    defer allocator.free(source);
+    return parse(allocator, path, source);
+}
+
+// path is only used to resolve rom and state against, and in errors.
+fn parse(allocator: std.mem.Allocator, path: []const u8, source: []const u8) !Script {
+    var cycles: ?u64 = null;
+    var rom: ?[]const u8 = null;
+    errdefer if (rom) |r| allocator.free(r);
+    var state: ?[]const u8 = null;
+    errdefer if (state) |s| allocator.free(s);
+    var presses = std.ArrayList(Press).init(allocator);
+    defer presses.deinit();
+    var expects = std.ArrayList(Expect).init(allocator);
+    defer expects.deinit();
+    // The line of the latest expect, to point at if it's past the end.
+    var latest_expect: ?struct { cycle: u64, lineno: usize } = null;
+
+    var lines = std.mem.split(u8, source, "\n");
+    var lineno: usize = 0;
+    while (lines.next()) |raw_line| {
+        lineno += 1;
+        const line = if (std.mem.indexOfScalar(u8, raw_line, '#')) |i| raw_line[0..i] else raw_line;
+
+        var words = std.mem.tokenize(u8, line, " \t\r");
+        const directive = words.next() orelse continue;
+
+        if (std.mem.eql(u8, directive, "cycles")) {
+            cycles = try parseUint(u64, 0, path, lineno, words.next());
+        } else if (std.mem.eql(u8, directive, "rom")) {
+            const rom_path = words.next() orelse return bad(path, lineno, "rom needs a path");
+            if (rom) |r| allocator.free(r);
+            rom = try std.fs.path.resolve(allocator, &.{ std.fs.path.dirname(path) orelse ".", rom_path });
+        } else if (std.mem.eql(u8, directive, "state")) {
+            const state_path = words.next() orelse return bad(path, lineno, "state needs a path");
+            if (state) |s| allocator.free(s);
+            state = try std.fs.path.resolve(allocator, &.{ std.fs.path.dirname(path) orelse ".", state_path });
+        } else if (std.mem.eql(u8, directive, "press")) {
+            const cycle = try parseUint(u64, 0, path, lineno, words.next());
+            const which = try parseUint(u8, 0, path, lineno, words.next());
+            try presses.append(.{ .cycle = cycle, .which = which });
+        } else if (std.mem.eql(u8, directive, "expect")) {
+            const cycle = try parseUint(u64, 0, path, lineno, words.next());
+            const crc = try parseUint(u32, 16, path, lineno, words.next());
+            try expects.append(.{ .cycle = cycle, .crc = crc });
+            if (latest_expect == null or cycle > latest_expect.?.cycle) {
+                latest_expect = .{ .cycle = cycle, .lineno = lineno };
+            }
+        } else {
+            return bad(path, lineno, "unknown directive");
+        }
+
+        if (words.next() != null) {
+            return bad(path, lineno, "trailing garbage");
+        }
+    }
+
+    const total = cycles orelse return bad(path, 0, "no cycles given");
+    if (latest_expect) |latest| {
+        if (latest.cycle > total) {
+            return bad(path, latest.lineno, "expect is past the script's cycles, so would never be checked");
+        }
+    }
+
+    std.sort.insertion(Press, presses.items, {}, struct {
+        fn lessThan(_: void, a: Press, b: Press) bool {
+            return a.cycle < b.cycle;
+        }
+    }.lessThan);
+    std.sort.insertion(Expect, expects.items, {}, struct {
+        fn lessThan(_: void, a: Expect, b: Expect) bool {
+            return a.cycle < b.cycle;
+        }
+    }.lessThan);
+
+    return .{
+        .allocator = allocator,
+        .path = path,
+        .cycles = total,
+        .rom = rom,
+        .state = state,
+        .presses = try presses.toOwnedSlice(),
+        .expects = try expects.toOwnedSlice(),
+    };
+}
+
+pub fn deinit(self: Script) void {
+    if (self.rom) |r| self.allocator.free(r);
+    if (self.state) |s| self.allocator.free(s);
+    self.allocator.free(self.presses);
+    self.allocator.free(self.expects);
+}
+
+fn parseUint(comptime T: type, base: u8, path: []const u8, lineno: usize, word: ?[]const u8) !T {
+    const w = word orelse return bad(path, lineno, "missing number");
+    return std.fmt.parseInt(T, w, base) catch return bad(path, lineno, "bad number");
+}
+
+fn bad(path: []const u8, lineno: usize, msg: []const u8) error{BadScript} {
+    std.debug.print("{s}:{d}: {s}\n", .{ path, lineno, msg });
+    return error.BadScript;
+}
+
+test "parse" {
+    const script = try parse(std.testing.allocator, "scripts/demo.vsh",
+        \\# A comment.
+        \\cycles 1000
+        \\
+        \\press 500 2   # pressed second,
+        \\press 100 1   # but listed first.
+        \\expect 1000 DEADbeef
+        \\expect 200 0
+    );
+    defer script.deinit();
+
+    try std.testing.expectEqual(@as(u64, 1000), script.cycles);
+    try std.testing.expect(script.rom == null);
+    try std.testing.expect(script.state == null);
+    try std.testing.expectEqualSlices(Press, &.{
+        .{ .cycle = 100, .which = 1 },
+        .{ .cycle = 500, .which = 2 },
+    }, script.presses);
+    try std.testing.expectEqualSlices(Expect, &.{
+        .{ .cycle = 200, .crc = 0 },
+        .{ .cycle = 1000, .crc = 0xdeadbeef },
+    }, script.expects);
+}
+
+test "parse resolves rom and state against the script" {
+    const script = try parse(std.testing.allocator, "scripts/demo.vsh",
+        \\cycles 1
+        \\rom ../roms/demo.bin
+        \\state demo.state
+    );
+    defer script.deinit();
+
+    try std.testing.expectEqualStrings("roms/demo.bin", script.rom.?);
+    try std.testing.expectEqualStrings("scripts/demo.state", script.state.?);
+
+    const bare = try parse(std.testing.allocator, "demo.vsh",
+        \\cycles 1
+        \\rom /abs/demo.bin
+        \\state demo.state
+    );
+    defer bare.deinit();
+
+    try std.testing.expectEqualStrings("/abs/demo.bin", bare.rom.?);
+    try std.testing.expectEqualStrings("demo.state", bare.state.?);
+}
+
+test "parse rejects bad scripts" {
+    const cases = [_][]const u8{
+        // No cycles.
+        "press 1 1\n",
+        "",
+        // An expect that would never be checked.
+        "cycles 100\nexpect 101 0\n",
+        "expect 101 0\ncycles 100\n",
+        // Trailing garbage.
+        "cycles 100 200\n",
+        "cycles 100\nexpect 10 0 0\n",
+        // Bad numbers.
+        "cycles 100\nexpect 10 deadbeeg\n",
+        "cycles 100\nexpect 10 100000000\n",
+        "cycles 100\nexpect 10\n",
+        "cycles -1\n",
+        "cycles 100\npress 10 256\n",
+        // Anything else.
+        "cycles 100\nrom\n",
+        "cycles 100\nstate\n",
+        "cycles 100\nwait 10\n",
+    };
+    for (cases) |source| {
+        try std.testing.expectError(error.BadScript, parse(std.testing.allocator, "bad.vsh", source));
+    }
+}
@@ -0,0 +1,40 @@
+const std = @import("std");
+const atomic = std.atomic;
+
+// A fixed-size ring for handing items from one producer thread to one consumer
+// thread without taking a lock.  head and tail run freely and are only ever
+// written by the consumer and producer respectively; they're kept on separate
+// cache lines so the two sides don't fight over them.
+pub fn Spsc(comptime T: type, comptime capacity: usize) type {
+    comptime std.debug.assert(std.math.isPowerOfTwo(capacity));
+
+    return struct {
+        const Self = @This();
+
+        head: atomic.Value(usize) align(64) = atomic.Value(usize).init(0),
+        tail: atomic.Value(usize) align(64) = atomic.Value(usize).init(0),
+        items: [capacity]T align(64) = undefined,
+
+        // Producer only.  Returns false if the ring's full.
+        pub fn push(self: *Self, item: T) bool {
+            const tail = self.tail.load(.Monotonic);
+            if (tail -% self.head.load(.Acquire) == capacity) {
+                return false;
+            }
+            self.items[tail % capacity] = item;
+            self.tail.store(tail +% 1, .Release);
+            return true;
+        }
+
+        // Consumer only.
+        pub fn pop(self: *Self) ?T {
+            const head = self.head.load(.Monotonic);
+            if (head == self.tail.load(.Acquire)) {
+                return null;
+            }
+            const item = self.items[head % capacity];
+            self.head.store(head +% 1, .Release);
+            return item;
+        }
+    };
+}
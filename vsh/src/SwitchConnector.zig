@@ -23,8 +23,15 @@ pub fn tick(self: *@This()) void {
     }
 }
 
-pub fn press(self: *@This()) void {
-    if (self.state == .Idle) {
-        self.state = .Pressing;
+pub fn quiet(self: @This()) bool {
+    return self.state == .Idle;
+}
+
+// Returns whether the press took; one already under way swallows it.
+pub fn press(self: *@This()) bool {
+    if (self.state != .Idle) {
+        return false;
     }
+    self.state = .Pressing;
+    return true;
 }
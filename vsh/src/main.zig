@@ -4,19 +4,56 @@ const gk = @import("gamekit");
 const DisplayBase = @import("./DisplayBase.zig");
 const Display = @import("./Display.zig");
 const Cxxrtl = @import("./Cxxrtl.zig");
+const FPGAThread = @import("./FPGAThread.zig");
+const Runner = @import("./Runner.zig");
 
 var display: Display = undefined;
 pub var write_vcd: bool = false;
+pub var vcd_from: u64 = 0;
+pub var vcd_to: ?u64 = null;
+pub var vcd_scope: ?[:0]const u8 = null;
+var headless: bool = false;
+var cycles: ?u64 = null;
+var press: u8 = 0;
+pub var clk_hz: ?u64 = null;
+pub var i2c_hz: ?u64 = null;
+// Checkpoints to start from, and (headless only) to save once --cycles are up.
+pub var load_state: ?[]const u8 = null;
+pub var save_state: ?[]const u8 = null;
+// Whether to measure and report press-to-pixel latency; see Latency.
+pub var trace_latency: bool = false;
+// Where to write a JSON report of the run at its end; see Report.
+pub var report: ?[]const u8 = null;
 
-export const spi_flash_content = @embedFile("rom.bin");
-export const spi_flash_base: u32 = 0xABCDEF;
-export const spi_flash_length: u32 = spi_flash_content.len;
+// The flash image the SPI flash blackboxes read from.  This is the ROM built
+// with vsh unless --rom is given, in which case that file is mapped in instead.
+const embedded_rom = @embedFile("rom.bin");
+export var spi_flash_content: [*]const u8 = embedded_rom;
+export var spi_flash_base: u32 = 0xABCDEF;
+export var spi_flash_length: u32 = embedded_rom.len;
 
 pub fn main() !void {
     var gpa = std.heap.GeneralPurposeAllocator(.{}){};
     defer _ = gpa.deinit();
 
     const allocator = gpa.allocator();
+    defer if (vcd_scope) |scope| allocator.free(scope);
+    defer if (load_state) |path| allocator.free(path);
+    defer if (save_state) |path| allocator.free(path);
+    defer if (report) |path| allocator.free(path);
+
+    var rom_mapping: ?[]align(std.mem.page_size) const u8 = null;
+    defer if (rom_mapping) |mapping| std.os.munmap(mapping);
+
+    var scripts = std.ArrayList([]const u8).init(allocator);
+    defer {
+        for (scripts.items) |script| allocator.free(script);
+        scripts.deinit();
+    }
+    var jobs: ?u32 = null;
+    var fb_out: ?[]const u8 = null;
+    var bless = false;
+    defer if (fb_out) |dir| allocator.free(dir);
 
     {
         var args = try std.process.argsWithAllocator(allocator);
@@ -28,6 +65,67 @@ pub fn main() !void {
         while (args.next()) |arg| {
             if (std.mem.eql(u8, arg, "-v") or std.mem.eql(u8, arg, "--vcd")) {
                 write_vcd = true;
+            } else if (std.mem.eql(u8, arg, "--vcd-from")) {
+                const value = args.next() orelse @panic("--vcd-from needs a value");
+                vcd_from = try std.fmt.parseInt(u64, value, 10);
+            } else if (std.mem.eql(u8, arg, "--vcd-to")) {
+                const value = args.next() orelse @panic("--vcd-to needs a value");
+                vcd_to = try std.fmt.parseInt(u64, value, 10);
+            } else if (std.mem.eql(u8, arg, "--vcd-scope")) {
+                const value = args.next() orelse @panic("--vcd-scope needs a value");
+                vcd_scope = try allocator.dupeZ(u8, value);
+            } else if (std.mem.eql(u8, arg, "--headless")) {
+                headless = true;
+            } else if (std.mem.eql(u8, arg, "--cycles")) {
+                const value = args.next() orelse @panic("--cycles needs a value");
+                cycles = try std.fmt.parseInt(u64, value, 10);
+            } else if (std.mem.eql(u8, arg, "--clk-hz")) {
+                const value = args.next() orelse @panic("--clk-hz needs a value");
+                clk_hz = try std.fmt.parseInt(u64, value, 10);
+            } else if (std.mem.eql(u8, arg, "--i2c-hz")) {
+                const value = args.next() orelse @panic("--i2c-hz needs a value");
+                i2c_hz = try std.fmt.parseInt(u64, value, 10);
+            } else if (std.mem.eql(u8, arg, "--rom")) {
+                const value = args.next() orelse @panic("--rom needs a value");
+                if (rom_mapping) |mapping| {
+                    std.os.munmap(mapping);
+                    rom_mapping = null;
+                }
+                rom_mapping = try mapRom(value);
+                spi_flash_content = if (rom_mapping) |mapping| mapping.ptr else embedded_rom;
+                spi_flash_length = if (rom_mapping) |mapping| @as(u32, @intCast(mapping.len)) else 0;
+            } else if (std.mem.eql(u8, arg, "--rom-base")) {
+                const value = args.next() orelse @panic("--rom-base needs a value");
+                spi_flash_base = try std.fmt.parseInt(u32, value, 0);
+            } else if (std.mem.eql(u8, arg, "--run")) {
+                const value = args.next() orelse @panic("--run needs a value");
+                try scripts.append(try allocator.dupe(u8, value));
+            } else if (std.mem.eql(u8, arg, "--jobs")) {
+                const value = args.next() orelse @panic("--jobs needs a value");
+                jobs = try std.fmt.parseInt(u32, value, 10);
+            } else if (std.mem.eql(u8, arg, "--bless")) {
+                bless = true;
+            } else if (std.mem.eql(u8, arg, "--fb-out")) {
+                const value = args.next() orelse @panic("--fb-out needs a value");
+                if (fb_out) |dir| allocator.free(dir);
+                fb_out = try allocator.dupe(u8, value);
+            } else if (std.mem.eql(u8, arg, "--load-state")) {
+                const value = args.next() orelse @panic("--load-state needs a value");
+                if (load_state) |path| allocator.free(path);
+                load_state = try allocator.dupe(u8, value);
+            } else if (std.mem.eql(u8, arg, "--save-state")) {
+                const value = args.next() orelse @panic("--save-state needs a value");
+                if (save_state) |path| allocator.free(path);
+                save_state = try allocator.dupe(u8, value);
+            } else if (std.mem.eql(u8, arg, "--report")) {
+                const value = args.next() orelse @panic("--report needs a value");
+                if (report) |path| allocator.free(path);
+                report = try allocator.dupe(u8, value);
+            } else if (std.mem.eql(u8, arg, "--trace-latency")) {
+                trace_latency = true;
+            } else if (std.mem.eql(u8, arg, "--press")) {
+                const value = args.next() orelse @panic("--press needs a value");
+                press = try std.fmt.parseInt(u8, value, 10);
             } else {
                 std.debug.print("ARG: {s}\n", .{arg});
                 @panic("unknown arg encountered");
@@ -35,6 +133,31 @@ pub fn main() !void {
         }
     }
 
+    if (scripts.items.len > 0) {
+        if (write_vcd) {
+            @panic("--vcd can't be used with --run");
+        }
+        if (save_state != null) {
+            @panic("--save-state can't be used with --run");
+        }
+        if (report != null) {
+            @panic("--report can't be used with --run");
+        }
+        if (!try Runner.run(allocator, scripts.items, jobs, fb_out, bless)) {
+            std.process.exit(1);
+        }
+        return;
+    }
+
+    if (save_state != null and !headless) {
+        @panic("--save-state needs --headless");
+    }
+
+    if (headless) {
+        try FPGAThread.run_headless(cycles orelse @panic("--headless needs --cycles"), press);
+        return;
+    }
+
     try gk.run(.{
         .init = gkInit,
         .update = gkUpdate,
@@ -49,6 +172,47 @@ pub fn main() !void {
     });
 }
 
+// The flash blackboxes take a copy of the spi_flash_* globals when they're
+// created, so designs with different images can be created as long as it's
+// done one at a time.
+var flash_mutex: std.Thread.Mutex = .{};
+
+pub fn createWithRom(rom: ?[]const u8) Cxxrtl {
+    flash_mutex.lock();
+    defer flash_mutex.unlock();
+
+    const content = spi_flash_content;
+    const length = spi_flash_length;
+    defer {
+        spi_flash_content = content;
+        spi_flash_length = length;
+    }
+
+    if (rom) |r| {
+        spi_flash_content = r.ptr;
+        spi_flash_length = @as(u32, @intCast(r.len));
+    }
+
+    return Cxxrtl.init();
+}
+
+// Maps the file at path read-only.  Returns null for an empty file, which
+// can't be mapped (and wouldn't have anything in it anyway).
+pub fn mapRom(path: []const u8) !?[]align(std.mem.page_size) const u8 {
+    const file = try std.fs.cwd().openFile(path, .{});
+    defer file.close();
+
+    const len = (try file.stat()).size;
+    if (len == 0) {
+        return null;
+    }
+    if (len > std.math.maxInt(u32)) {
+        return error.RomTooLarge;
+    }
+
+    return try std.os.mmap(null, len, std.os.PROT.READ, std.os.MAP.PRIVATE, file.handle, 0);
+}
+
 fn gkInit() anyerror!void { // XXX
     display = try Display.init();
 }